@@ -22,20 +22,50 @@ int main(int argc, const char ** argv) {
     int nsteps = get_option_int("nsteps"); // Number of steps
     float rbound = get_option_float("rbound", 0); // Ratio of lower bound  of stop walks
     float rboundin = get_option_float("rboundin", 0); // Ratio of lower bound  of interval stop walks
+    uint32_t seed = get_option_int("seed", (int)time(NULL)); // Seed of the walks, fixed for reproducible runs
+    float alpha = get_option_float("ppr.alpha", 0); // Restart probability, personalized PageRank walks if > 0
+    bool weighted = get_option_int("weighted", 0) == 1; // Third column of the edge list is the edge weight
+    float returnp = get_option_float("node2vec.p", 1); // node2vec return parameter
+    float inoutq = get_option_float("node2vec.q", 1); // node2vec in-out parameter, first-order walks if p = q = 1
+    std::string pathformat = get_option_string("paths", "none"); // Write the walk paths: none, binary or text
+    std::string direction = get_option_string("walk.direction", "out"); // Edges a step follows: out, in, alternate or random
+    float inprob = get_option_float("walk.inprob", 0.5); // Probability of an in-edge step with walk.direction random
     
     /* Detect the number of shards or preprocess an input to create them */
     /*bool preexisting_shards;
     int nshards = convert_if_notexists<vid_t>(filename, get_option_string("nshards", "auto"), preexisting_shards);*/
-    char *bidx = (char*) malloc(nvertices*sizeof(char));
-    BfsPartition bfs_partition_obj(filename);
-    int nblocks = bfs_partition_obj.partition(&bidx);
+    int dir = direction == "out" ? RandomWalkProgram::DIRECTION_OUT : direction == "in" ? RandomWalkProgram::DIRECTION_IN
+        : direction == "alternate" ? RandomWalkProgram::DIRECTION_ALTERNATE : direction == "random" ? RandomWalkProgram::DIRECTION_RANDOM : -1;
+    if (dir < 0) {
+        logstream(LOG_FATAL) << "Unknown walk.direction " << direction << ", expected out, in, alternate or random." << std::endl;
+        assert(false);
+    }
+    if (weighted && dir != RandomWalkProgram::DIRECTION_OUT) {
+        logstream(LOG_FATAL) << "Weighted walks only follow out-edges, walk.direction has to be out." << std::endl;
+        assert(false);
+    }
+    blockMap bidx;
+    BfsPartition bfs_partition_obj(filename, weighted, dir != RandomWalkProgram::DIRECTION_OUT);
+    int nblocks = bfs_partition_obj.partition(bidx);
 
     /* Run */
     RandomWalkProgram program;
-    program.initialization( nvertices, nwalks, nsteps, rbound, rboundin, bidx );
-    graphwalker_engine engine(filename, nblocks, m);
+    program.initialization( nvertices, nwalks, nsteps, rbound, rboundin, &bidx, seed );
+    if (alpha > 0)
+        program.initializePPR( alpha, get_option_string("ppr.seeds"), get_option_int("ppr.topk", 10), get_option_int("ppr.sketch_width", 1024) );
+    if (dir != RandomWalkProgram::DIRECTION_OUT)
+        program.initializeDirection( dir, inprob );
+    if (returnp != 1 || inoutq != 1)
+        program.initializeNode2vec( returnp, inoutq );
+    if (pathformat != "none" && pathformat != "binary" && pathformat != "text") {
+        logstream(LOG_FATAL) << "Unknown paths format " << pathformat << ", expected none, binary or text." << std::endl;
+        assert(false);
+    }
+    if (pathformat != "none")
+        program.initializePaths( filename, pathformat == "text" ? walkPathWriter::FORMAT_TEXT : walkPathWriter::FORMAT_BINARY,
+            get_option_int("execthreads", omp_get_max_threads()), (size_t)get_option_int("paths.membudget_mb", 256) * 1024 * 1024 );
+    graphwalker_engine engine(filename, nblocks, nvertices, &bidx, m);
     engine.run(program);
-    free(bidx);
     
     /* List top 20 */
     /*int ntop = 20;
@@ -53,6 +83,10 @@ int main(int argc, const char ** argv) {
      for(int i=0; i < (int) top.size(); i++) {
         deg += top[i].value * top[i].value;
      }*/
+    if (alpha > 0)
+        program.writePPR(filename + ".ppr");
+    if (pathformat != "none")
+        program.writePaths(filename + (pathformat == "text" ? ".paths.txt" : ".paths"));
     std::cout << "average degree : " << program.count << " " << program.degree*1.0/program.count << std::endl;
 
     /* Report execution metrics */
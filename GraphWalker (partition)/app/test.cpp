@@ -1,16 +1,16 @@
 #include <iostream>
 #include <string>
 
+#include "api/cmdopts.hpp"
 #include "preprocess/bfspartition.hpp"
 
 int main(int argc, char const *argv[])
 {
-    std::string filename = "../dataset/C++-LiveJournal1/soc-LiveJournal1.txt";
-    int nvertices = 4847571;
-    char *bidx = (char*) malloc(nvertices*sizeof(char));
+    set_argc(argc, argv);
+    std::string filename = get_option_string("file", "../dataset/C++-LiveJournal1/soc-LiveJournal1.txt");
+    blockMap bidx;
     BfsPartition bfs_partition_obj(filename);
-    int nblocks = bfs_partition_obj.partition(&bidx);
-    std::cout << nblocks << std::endl;
-    free(bidx);
+    int nblocks = bfs_partition_obj.partition(bidx);
+    std::cout << nblocks << " " << bidx.nvertices() << std::endl;
     return 0;
 }
\ No newline at end of file
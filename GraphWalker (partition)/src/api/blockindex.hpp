@@ -0,0 +1,61 @@
+#ifndef DEF_GRAPHWALKER_BLOCKINDEX
+#define DEF_GRAPHWALKER_BLOCKINDEX
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+#include "api/datatype.hpp"
+
+/**
+ * Maps the vertex ids of a loaded block to their offsets in the block.
+ * Works on the sorted vertex id array of the block in place; a block
+ * covering a contiguous id range is resolved by subtraction, otherwise
+ * by binary search.
+ */
+class blockIndex
+{
+private:
+    const vid_t *vids;
+    int n;
+    bool contiguous;
+public:
+    blockIndex() : vids(NULL), n(0), contiguous(false) {}
+
+    /* The ids have to be sorted and stay valid while the index is used. */
+    void build( const vid_t *sortedvids, int _n ){
+        vids = sortedvids;
+        n = _n;
+        contiguous = n > 0 && vids[n-1] - vids[0] == (vid_t)(n-1);
+    }
+
+    void clear(){
+        vids = NULL;
+        n = 0;
+        contiguous = false;
+    }
+
+    int size() const {
+        return n;
+    }
+
+    /* Offset of v in the block, or -1 if v is not in the block. */
+    int find( vid_t v ) const {
+        if( n == 0 ) return -1;
+        if( contiguous ){
+            if( v < vids[0] || v > vids[n-1] ) return -1;
+            return (int)(v - vids[0]);
+        }
+        const vid_t *it = std::lower_bound(vids, vids + n, v);
+        if( it == vids + n || *it != v ) return -1;
+        return (int)(it - vids);
+    }
+
+    int operator[]( vid_t v ) const {
+        int off = find(v);
+        assert( off >= 0 );
+        return off;
+    }
+};
+
+#endif
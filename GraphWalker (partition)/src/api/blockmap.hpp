@@ -0,0 +1,125 @@
+#ifndef DEF_GRAPHWALKER_BLOCKMAP
+#define DEF_GRAPHWALKER_BLOCKMAP
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "logger/logger.hpp"
+#include "api/datatype.hpp"
+#include "api/io.hpp"
+
+/**
+ * On-disk map from every vertex to its block: a header followed by one
+ * block id per vertex, 16 bits wide if the graph has at most 65535
+ * blocks and 32 bits otherwise. The file is written by the partitioner
+ * and mapped by later runs, which then do not partition again.
+ */
+#define BLOCKMAP_MAGIC 0x58425747   // "GWBX"
+#define BLOCKMAP_VERSION 1
+#define BLOCKMAP_DATAOFF 64
+
+struct blockMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t idbytes;
+    uint32_t nblocks;
+    uint64_t nvertices;
+    uint64_t blocksize;     // block size the graph was partitioned with
+};
+
+/**
+ * Writes the map; block[v] is the block of vertex v.
+ */
+static void write_block_map( std::string fname, const std::vector<int> &block, int nblocks, uint64_t blocksize ){
+    blockMapHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = BLOCKMAP_MAGIC;
+    hdr.version = BLOCKMAP_VERSION;
+    hdr.idbytes = nblocks <= 0xffff ? 2 : 4;
+    hdr.nblocks = nblocks;
+    hdr.nvertices = block.size();
+    hdr.blocksize = blocksize;
+
+    size_t sz = BLOCKMAP_DATAOFF + hdr.nvertices * hdr.idbytes;
+    char * buf = (char*) calloc(sz, 1);
+    memcpy(buf, &hdr, sizeof(hdr));
+    if( hdr.idbytes == 2 ){
+        uint16_t *ids = (uint16_t*)(buf + BLOCKMAP_DATAOFF);
+        for( size_t v = 0; v < block.size(); v++ ) ids[v] = (uint16_t)block[v];
+    }else{
+        uint32_t *ids = (uint32_t*)(buf + BLOCKMAP_DATAOFF);
+        for( size_t v = 0; v < block.size(); v++ ) ids[v] = (uint32_t)block[v];
+    }
+    char * bufptr = buf + sz;
+    writefile(fname, buf, bufptr);
+    free(buf);
+}
+
+/**
+ * Read-only, memory-mapped vertex to block map.
+ */
+class blockMap
+{
+private:
+    char *mapped;
+    size_t mappedsize;
+    const blockMapHeader *hdr;
+    const uint16_t *ids16;
+    const uint32_t *ids32;
+public:
+    blockMap() : mapped(NULL), mappedsize(0), hdr(NULL), ids16(NULL), ids32(NULL) {}
+
+    ~blockMap(){
+        release();
+    }
+
+    /* Maps the file; returns false if it is missing or not a valid version of the map. */
+    bool load( std::string fname ){
+        release();
+        int f = open(fname.c_str(), O_RDONLY);
+        if( f < 0 ) return false;
+        size_t sz = lseek(f, 0, SEEK_END);
+        if( sz < BLOCKMAP_DATAOFF ){
+            close(f);
+            return false;
+        }
+        mapped = (char*) mmap(NULL, sz, PROT_READ, MAP_SHARED | MAP_POPULATE, f, 0);
+        close(f);
+        assert( mapped != MAP_FAILED );
+        mappedsize = sz;
+        hdr = (const blockMapHeader*)mapped;
+        if( hdr->magic != BLOCKMAP_MAGIC || hdr->version != BLOCKMAP_VERSION || (hdr->idbytes != 2 && hdr->idbytes != 4)
+            || sz != BLOCKMAP_DATAOFF + hdr->nvertices * hdr->idbytes ){
+            logstream(LOG_WARNING) << "Ignoring block map " << fname << ", it is not a version " << BLOCKMAP_VERSION << " map." << std::endl;
+            release();
+            return false;
+        }
+        if( hdr->idbytes == 2 ) ids16 = (const uint16_t*)(mapped + BLOCKMAP_DATAOFF);
+        else ids32 = (const uint32_t*)(mapped + BLOCKMAP_DATAOFF);
+        return true;
+    }
+
+    void release(){
+        if( mapped != NULL ) munmap(mapped, mappedsize);
+        mapped = NULL;
+        mappedsize = 0;
+        hdr = NULL;
+        ids16 = NULL;
+        ids32 = NULL;
+    }
+
+    int nblocks() const { return hdr->nblocks; }
+    size_t nvertices() const { return hdr->nvertices; }
+    size_t blocksize() const { return hdr->blocksize; }
+
+    int block( vid_t v ) const {
+        return ids16 != NULL ? (int)ids16[v] : (int)ids32[v];
+    }
+};
+
+#endif
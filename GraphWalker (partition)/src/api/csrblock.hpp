@@ -0,0 +1,385 @@
+#ifndef DEF_GRAPHWALKER_CSRBLOCK
+#define DEF_GRAPHWALKER_CSRBLOCK
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+
+#include "logger/logger.hpp"
+#include "api/datatype.hpp"
+#include "api/blockindex.hpp"
+#include "api/io.hpp"
+#include "walks/walkrandom.hpp"
+
+/**
+ * On-disk layout of a block file: header, sorted vertex ids, offsets of
+ * the neighbor lists (nverts + 1 entries) and the contiguous neighbor
+ * array, each list sorted by id. A weighted graph adds one float per edge, which is the edge
+ * weight in the converted graph and the alias probability in a block;
+ * blocks then also carry the alias of every edge, an index into the
+ * neighbor list of its vertex. Blocks of a graph walked along in-edges
+ * also hold the in-edges of their vertices, as offsets and a sorted array
+ * of source ids indexed like the out-edges. Every section starts at a 64-byte
+ * boundary, so a mapped or read block is used in place without
+ * deserialization.
+ */
+#define CSRBLOCK_MAGIC 0x4b425747   // "GWBK"
+#define CSRBLOCK_VERSION 4
+#define CSRBLOCK_ALIGN 64
+
+/* Header flags */
+#define CSRBLOCK_WEIGHTS 1      // per-edge weights in the prob section
+#define CSRBLOCK_ALIAS 2        // per-edge alias probabilities and aliases
+#define CSRBLOCK_REVERSE 4      // in-edges of every vertex
+
+struct csrBlockHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nverts;
+    uint32_t flags;
+    uint64_t nedges;
+    uint64_t vidoff;
+    uint64_t begoff;
+    uint64_t nbroff;
+    uint64_t proboff;
+    uint64_t aliasoff;
+    uint64_t ninedges;
+    uint64_t inbegoff;
+    uint64_t innbroff;
+    uint64_t size;
+};
+
+static inline uint64_t csr_align( uint64_t off ){
+    return (off + CSRBLOCK_ALIGN - 1) / CSRBLOCK_ALIGN * CSRBLOCK_ALIGN;
+}
+
+static void write_csr_section( int f, uint64_t &pos, uint64_t off, const void *data, size_t nbytes ){
+    static const char zeros[CSRBLOCK_ALIGN] = {0};
+    assert( off - pos <= CSRBLOCK_ALIGN );
+    if( off > pos ) writea(f, zeros, off - pos);
+    if( nbytes > 0 ) writea(f, (const char*)data, nbytes);
+    pos = off + nbytes;
+}
+
+/**
+ * Writes a block file from the sorted vertex ids, the nverts + 1 offsets
+ * of the neighbor lists and the neighbor array, plus the weights or the
+ * alias tables and the in-edges selected by flags. The sections are
+ * written one after the other, so a whole graph can be stored without
+ * staging it in a second buffer.
+ */
+static void write_csr_file( std::string fname, const vid_t *vids, const uint32_t *beg, const vid_t *nbrs, uint32_t nverts,
+        uint32_t flags = 0, const float *probs = NULL, const uint32_t *alias = NULL,
+        const uint32_t *inbeg = NULL, const vid_t *innbrs = NULL ){
+    csrBlockHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = CSRBLOCK_MAGIC;
+    hdr.version = CSRBLOCK_VERSION;
+    hdr.nverts = nverts;
+    hdr.flags = flags;
+    hdr.nedges = beg[nverts];
+    hdr.vidoff = csr_align(sizeof(hdr));
+    hdr.begoff = csr_align(hdr.vidoff + hdr.nverts * sizeof(vid_t));
+    hdr.nbroff = csr_align(hdr.begoff + (hdr.nverts + 1) * sizeof(uint32_t));
+    hdr.size = hdr.nbroff + hdr.nedges * sizeof(vid_t);
+    if( flags & (CSRBLOCK_WEIGHTS | CSRBLOCK_ALIAS) ){
+        hdr.proboff = csr_align(hdr.size);
+        hdr.size = hdr.proboff + hdr.nedges * sizeof(float);
+    }
+    if( flags & CSRBLOCK_ALIAS ){
+        hdr.aliasoff = csr_align(hdr.size);
+        hdr.size = hdr.aliasoff + hdr.nedges * sizeof(uint32_t);
+    }
+    if( flags & CSRBLOCK_REVERSE ){
+        hdr.ninedges = inbeg[nverts];
+        hdr.inbegoff = csr_align(hdr.size);
+        hdr.innbroff = csr_align(hdr.inbegoff + (hdr.nverts + 1) * sizeof(uint32_t));
+        hdr.size = hdr.innbroff + hdr.ninedges * sizeof(vid_t);
+    }
+
+    int f = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+    if (f < 0) {
+        logstream(LOG_FATAL) << "Could not open " << fname << " error: " << strerror(errno) << std::endl;
+    }
+    assert(f >= 0);
+    uint64_t pos = 0;
+    write_csr_section(f, pos, 0, &hdr, sizeof(hdr));
+    write_csr_section(f, pos, hdr.vidoff, vids, hdr.nverts * sizeof(vid_t));
+    write_csr_section(f, pos, hdr.begoff, beg, (hdr.nverts + 1) * sizeof(uint32_t));
+    write_csr_section(f, pos, hdr.nbroff, nbrs, hdr.nedges * sizeof(vid_t));
+    if( hdr.proboff > 0 )
+        write_csr_section(f, pos, hdr.proboff, probs, hdr.nedges * sizeof(float));
+    if( hdr.aliasoff > 0 )
+        write_csr_section(f, pos, hdr.aliasoff, alias, hdr.nedges * sizeof(uint32_t));
+    if( hdr.inbegoff > 0 ){
+        write_csr_section(f, pos, hdr.inbegoff, inbeg, (hdr.nverts + 1) * sizeof(uint32_t));
+        write_csr_section(f, pos, hdr.innbroff, innbrs, hdr.ninedges * sizeof(vid_t));
+    }
+    assert( pos == hdr.size );
+    close(f);
+}
+
+/* Reads only the header of a block file; false if it is missing or of another version. */
+static bool read_csr_header( std::string fname, csrBlockHeader &hdr ){
+    int f = open(fname.c_str(), O_RDONLY);
+    if( f < 0 ) return false;
+    bool ok = pread(f, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr);
+    close(f);
+    return ok && hdr.magic == CSRBLOCK_MAGIC && hdr.version == CSRBLOCK_VERSION;
+}
+
+/**
+ * Builds the alias table of one neighbor list from its weights in O(n)
+ * (Vose's method): edge j is kept with probability prob[j], otherwise
+ * its alias is taken.
+ */
+static void build_alias_table( const float *weights, int n, float *prob, uint32_t *alias ){
+    double sum = 0;
+    for( int j = 0; j < n; j++ ) sum += weights[j];
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for( int j = 0; j < n; j++ ){
+        scaled[j] = sum > 0 ? weights[j] * n / sum : 1.0;
+        if( scaled[j] < 1.0 ) small.push_back(j);
+        else large.push_back(j);
+    }
+    while( !small.empty() && !large.empty() ){
+        int l = small.back(), g = large.back();
+        small.pop_back();
+        prob[l] = (float)scaled[l];
+        alias[l] = g;
+        scaled[g] -= 1.0 - scaled[l];
+        if( scaled[g] < 1.0 ){
+            large.pop_back();
+            small.push_back(g);
+        }
+    }
+    /* What is left has probability 1 up to rounding */
+    for( unsigned i = 0; i < large.size(); i++ ){
+        prob[large[i]] = 1.0f;
+        alias[large[i]] = large[i];
+    }
+    for( unsigned i = 0; i < small.size(); i++ ){
+        prob[small[i]] = 1.0f;
+        alias[small[i]] = small[i];
+    }
+}
+
+/**
+ * Read-only CSR view of a block held in memory.
+ */
+class csrBlock
+{
+private:
+    const csrBlockHeader *hdr;
+    const vid_t *vids;
+    const uint32_t *beg;
+    const vid_t *nbrs;
+    const float *probs;
+    const uint32_t *aliases;
+    const uint32_t *inbeg;
+    const vid_t *innbrs;
+public:
+    blockIndex index;
+
+    csrBlock() : hdr(NULL), vids(NULL), beg(NULL), nbrs(NULL), probs(NULL), aliases(NULL), inbeg(NULL), innbrs(NULL) {}
+
+    void attach( const char *data, size_t sz, std::string name ){
+        hdr = (const csrBlockHeader*)data;
+        if( sz < sizeof(csrBlockHeader) || hdr->magic != CSRBLOCK_MAGIC || hdr->version != CSRBLOCK_VERSION || hdr->size != sz ){
+            logstream(LOG_FATAL) << "Block file " << name << " is not a version " << CSRBLOCK_VERSION << " CSR block, repartition the graph." << std::endl;
+            assert(false);
+        }
+        vids = (const vid_t*)(data + hdr->vidoff);
+        beg = (const uint32_t*)(data + hdr->begoff);
+        nbrs = (const vid_t*)(data + hdr->nbroff);
+        probs = hdr->proboff > 0 ? (const float*)(data + hdr->proboff) : NULL;
+        aliases = hdr->aliasoff > 0 ? (const uint32_t*)(data + hdr->aliasoff) : NULL;
+        inbeg = hdr->inbegoff > 0 ? (const uint32_t*)(data + hdr->inbegoff) : NULL;
+        innbrs = hdr->innbroff > 0 ? (const vid_t*)(data + hdr->innbroff) : NULL;
+        index.build(vids, hdr->nverts);
+    }
+
+    void detach(){
+        hdr = NULL;
+        vids = nbrs = NULL;
+        beg = NULL;
+        probs = NULL;
+        aliases = NULL;
+        inbeg = NULL;
+        innbrs = NULL;
+        index.clear();
+    }
+
+    int nverts() const { return hdr->nverts; }
+    size_t nedges() const { return hdr->nedges; }
+    vid_t vid( int i ) const { return vids[i]; }
+    int outd( int i ) const { return beg[i+1] - beg[i]; }
+    const vid_t *outv( int i ) const { return nbrs + beg[i]; }
+    uint32_t flags() const { return hdr->flags; }
+    /* Edge weights of a converted graph, alias probabilities of a block */
+    const float *prob( int i ) const { return probs + beg[i]; }
+    const uint32_t *alias( int i ) const { return aliases + beg[i]; }
+    bool weighted() const { return aliases != NULL; }
+    /* In-edges, only if reversed() */
+    int ind( int i ) const { return inbeg[i+1] - inbeg[i]; }
+    const vid_t *inv( int i ) const { return innbrs + inbeg[i]; }
+    bool reversed() const { return inbeg != NULL; }
+};
+
+/**
+ * Writes the given vertices of graph as one block file, with their
+ * in-edges if the graph has them. The vertex ids are sorted in place.
+ */
+static void write_csr_block( std::string fname, const csrBlock &graph, std::vector<vid_t> &vertices ){
+    std::sort(vertices.begin(), vertices.end());
+    std::vector<uint32_t> beg(vertices.size() + 1);
+    std::vector<vid_t> nbrs;
+    uint64_t off = 0;
+    for( unsigned i = 0; i < vertices.size(); i++ ){
+        beg[i] = (uint32_t)off;
+        off += graph.outd(graph.index[vertices[i]]);
+    }
+    assert( off <= 0xffffffffu );
+    beg[vertices.size()] = (uint32_t)off;
+    nbrs.resize(off);
+    bool weighted = (graph.flags() & CSRBLOCK_WEIGHTS) != 0;
+    std::vector<float> probs(weighted ? off : 0);
+    std::vector<uint32_t> alias(weighted ? off : 0);
+    for( unsigned i = 0; i < vertices.size(); i++ ){
+        int y = graph.index[vertices[i]];
+        if( graph.outd(y) > 0 ){
+            memcpy(&nbrs[beg[i]], graph.outv(y), graph.outd(y) * sizeof(vid_t));
+            if( weighted )
+                build_alias_table(graph.prob(y), graph.outd(y), &probs[beg[i]], &alias[beg[i]]);
+        }
+    }
+    std::vector<uint32_t> inbeg;
+    std::vector<vid_t> innbrs;
+    if( graph.reversed() ){
+        inbeg.resize(vertices.size() + 1);
+        off = 0;
+        for( unsigned i = 0; i < vertices.size(); i++ ){
+            inbeg[i] = (uint32_t)off;
+            off += graph.ind(graph.index[vertices[i]]);
+        }
+        assert( off <= 0xffffffffu );
+        inbeg[vertices.size()] = (uint32_t)off;
+        innbrs.resize(off);
+        for( unsigned i = 0; i < vertices.size(); i++ ){
+            int y = graph.index[vertices[i]];
+            if( graph.ind(y) > 0 )
+                memcpy(&innbrs[inbeg[i]], graph.inv(y), graph.ind(y) * sizeof(vid_t));
+        }
+    }
+    uint32_t flags = (weighted ? CSRBLOCK_ALIAS : 0) | (graph.reversed() ? CSRBLOCK_REVERSE : 0);
+    write_csr_file(fname, vertices.empty() ? NULL : &vertices[0], &beg[0], nbrs.empty() ? NULL : &nbrs[0], (uint32_t)vertices.size(),
+        flags, probs.empty() ? NULL : &probs[0], alias.empty() ? NULL : &alias[0],
+        inbeg.empty() ? NULL : &inbeg[0], innbrs.empty() ? NULL : &innbrs[0]);
+}
+
+/**
+ * Holds one loaded block. With mmap the file is mapped with MAP_POPULATE,
+ * otherwise it is read with a single pread into an arena that is reused
+ * by the following loads.
+ */
+class blockLoader
+{
+private:
+    bool use_mmap;
+    char *arena;
+    size_t arenasize;
+    char *mapped;
+    size_t mappedsize;
+public:
+    csrBlock block;
+
+    blockLoader( bool _use_mmap ) : use_mmap(_use_mmap), arena(NULL), arenasize(0), mapped(NULL), mappedsize(0) {}
+
+    ~blockLoader(){
+        release();
+        if( arena != NULL ) free(arena);
+    }
+
+    /* Returns the number of bytes brought into memory. */
+    size_t load( std::string bname ){
+        release();
+        int f = open(bname.c_str(), O_RDONLY);
+        if (f < 0) {
+            logstream(LOG_FATAL) << "Could not load :" << bname << " error: " << strerror(errno) << std::endl;
+        }
+        assert(f >= 0);
+        size_t sz = lseek(f, 0, SEEK_END);
+        if( use_mmap ){
+            mapped = (char*) mmap(NULL, sz, PROT_READ, MAP_PRIVATE | MAP_POPULATE, f, 0);
+            assert( mapped != MAP_FAILED );
+            mappedsize = sz;
+            block.attach(mapped, sz, bname);
+        }else{
+            if( sz > arenasize ){
+                if( arena != NULL ) free(arena);
+                int err = posix_memalign((void**)&arena, CSRBLOCK_ALIGN, sz);
+                assert( err == 0 );
+                arenasize = sz;
+            }
+            preada(f, arena, sz, 0);
+            block.attach(arena, sz, bname);
+        }
+        close(f);
+        return sz;
+    }
+
+    void release(){
+        block.detach();
+        if( mapped != NULL ){
+            munmap(mapped, mappedsize);
+            mapped = NULL;
+            mappedsize = 0;
+        }
+    }
+};
+
+#define SORTED_SCAN_LENGTH 32
+
+/**
+ * Whether x is in the sorted array a of n ids. Long arrays are narrowed
+ * down by a branchless binary search, and the rest is counted in one
+ * scan without branches, which the compiler vectorizes.
+ */
+static inline bool sorted_contains( const vid_t *a, uint32_t n, vid_t x ){
+    /* The first x, if any, stays within a[0, n) */
+    while( n > SORTED_SCAN_LENGTH ){
+        uint32_t half = n / 2;
+        a = a[half - 1] < x ? a + half : a;
+        n -= half;
+    }
+    uint32_t less = 0;
+    for( uint32_t i = 0; i < n; i++ )
+        less += a[i] < x;
+    return less < n && a[less] == x;
+}
+
+/* Whether the vertex at offset i of the block has an edge to x. */
+static inline bool has_outneighbor( const csrBlock &block, int i, vid_t x ){
+    return sorted_contains(block.outv(i), block.outd(i), x);
+}
+
+/* Uniform, or by edge weight in O(1) from the alias table of a weighted block. */
+static inline vid_t random_outneighbor( const csrBlock &block, int i, walkRandom &rng ) {
+    uint32_t j = rng.below(block.outd(i));
+    if( block.weighted() && rng.uniform() >= block.prob(i)[j] )
+        j = block.alias(i)[j];
+    return block.outv(i)[j];
+}
+
+/* Uniform over the in-edges of a reversed block. */
+static inline vid_t random_inneighbor( const csrBlock &block, int i, walkRandom &rng ) {
+    return block.inv(i)[rng.below(block.ind(i))];
+}
+
+#endif
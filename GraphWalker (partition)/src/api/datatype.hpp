@@ -11,7 +11,8 @@ struct Vertex{
     std::vector<vid_t> outv;	
 };
 
- vid_t random_outneighbor( Vertex v) {
-    return v.outv[(int) (std::abs(random()) % v.outd)];
+ inline bool vertexIdLess( const Vertex &a, const Vertex &b ) {
+    return a.vid < b.vid;
 }
+
 #endif
\ No newline at end of file
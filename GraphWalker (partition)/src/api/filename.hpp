@@ -14,26 +14,43 @@
 #include "api/datatype.hpp"
 #include "logger/logger.hpp"
 
-static std::string intervalname( std::string basefilename, int invlid ){
+static inline std::string csrname( std::string basefilename ){
+    return basefilename + ".csr";
+}
+
+static inline std::string blockname( std::string basefilename, int blockid ){
     std::stringstream ss;
     ss << basefilename;
-    ss << "_invl/invl";
-    ss << "_" << invlid << ".outlink";
+    ss << "_block/block";
+    ss << "_" << blockid << ".outlink";
     return ss.str();
 }
 
-static std::string blockname( std::string basefilename, int blockid ){
+static inline std::string walksname( std::string basefilename, int blockid ){
     std::stringstream ss;
     ss << basefilename;
-    ss << "_block/block";
-    ss << "_" << blockid << ".outlink";
+    ss << "_block/walks";
+    ss << "_" << blockid << ".bin";
     return ss.str();
 }
 
+/* Bucket of recorded walk steps, see walkPathWriter */
+static inline std::string pathsname( std::string basefilename, int bucket ){
+    std::stringstream ss;
+    ss << basefilename;
+    ss << "_block/paths";
+    ss << "_" << bucket << ".bin";
+    return ss.str();
+}
+
+static inline std::string bidxname( std::string basefilename ){
+    return basefilename + "_block/bidx";
+}
+
 /**
  * Configuration file name
  */
-static std::string filename_config() {
+static inline std::string filename_config() {
     char * chi_root = getenv("GRAPHCHI_ROOT");
     if (chi_root != NULL) {
         return std::string(chi_root) + "/conf/graphchi.cnf";
@@ -46,7 +63,7 @@ static std::string filename_config() {
  * Configuration file name - local version which can
  * override the version in the version control.
  */
-static std::string filename_config_local() {
+static inline std::string filename_config_local() {
     char * chi_root = getenv("GRAPHCHI_ROOT");
     if (chi_root != NULL) {
         return std::string(chi_root) + "/conf/graphwalker.local.cnf";
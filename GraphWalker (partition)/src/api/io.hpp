@@ -53,7 +53,7 @@ size_t readfull(int f, T ** buf) {
 
     template <typename T>
     void writefile(std::string fname, T * buf, T * &bufptr){
-        int f = open(fname.c_str(), O_WRONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+        int f = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
         if (f < 0) {
             logstream(LOG_ERROR) << "Could not open " << fname << " error: " << strerror(errno) << std::endl;
         }
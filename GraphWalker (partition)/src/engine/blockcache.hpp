@@ -0,0 +1,111 @@
+#ifndef DEF_GRAPHWALKER_BLOCKCACHE
+#define DEF_GRAPHWALKER_BLOCKCACHE
+
+#include <vector>
+
+#include "api/csrblock.hpp"
+#include "walks/walk.hpp"
+
+/**
+ * Keeps loaded blocks resident within a memory budget. When the budget
+ * is exceeded, the block with the fewest pending walks is evicted first,
+ * as it is the least likely to be scheduled again soon; ties go to the
+ * least recently used block. The block table is read-only while walks
+ * execute, so walks may step from one resident block into another.
+ */
+class blockCache
+{
+private:
+    std::vector<blockLoader*> loaders;
+    std::vector<const csrBlock*> table;
+    std::vector<size_t> bytes;
+    std::vector<size_t> lastuse;
+    std::vector<int> residentlist;
+    size_t budget, used, clock;
+    bool use_mmap;
+
+public:
+    size_t hits, misses, evictions;
+
+    blockCache( int nblocks, size_t _budget, bool _use_mmap ) : budget(_budget), used(0), clock(0), use_mmap(_use_mmap),
+        hits(0), misses(0), evictions(0) {
+        loaders.assign(nblocks, NULL);
+        table.assign(nblocks, NULL);
+        bytes.assign(nblocks, 0);
+        lastuse.assign(nblocks, 0);
+    }
+
+    ~blockCache(){
+        for( unsigned p = 0; p < loaders.size(); p++ )
+            if( loaders[p] != NULL ) delete loaders[p];
+    }
+
+    /* A loader for a block that is going to be inserted. */
+    blockLoader *newLoader(){
+        return new blockLoader(use_mmap);
+    }
+
+    void insert( int p, blockLoader *loader, size_t sz ){
+        assert( loaders[p] == NULL );
+        loaders[p] = loader;
+        table[p] = &loader->block;
+        bytes[p] = sz;
+        lastuse[p] = ++clock;
+        used += sz;
+        residentlist.push_back(p);
+    }
+
+    /* Resident block p, or NULL. Safe to call concurrently during walk execution. */
+    const csrBlock *block( int p ) const {
+        return table[p];
+    }
+
+    bool resident( int p ) const {
+        return table[p] != NULL;
+    }
+
+    /* Looks up p for execution and counts the hit or miss. */
+    const csrBlock *use( int p ){
+        if( table[p] == NULL ){
+            misses++;
+            return NULL;
+        }
+        hits++;
+        lastuse[p] = ++clock;
+        return table[p];
+    }
+
+    /* Evicts blocks other than pinned until the budget is met. */
+    void evict( walkManager &walk_manager, int pinned ){
+        while( used > budget && residentlist.size() > 1 ){
+            int victim = -1, vi = -1;
+            for( unsigned i = 0; i < residentlist.size(); i++ ){
+                int p = residentlist[i];
+                if( p == pinned ) continue;
+                if( victim < 0 || walk_manager.getWalksDis(p) < walk_manager.getWalksDis(victim)
+                    || (walk_manager.getWalksDis(p) == walk_manager.getWalksDis(victim) && lastuse[p] < lastuse[victim]) ){
+                    victim = p;
+                    vi = i;
+                }
+            }
+            residentlist[vi] = residentlist.back();
+            residentlist.pop_back();
+            used -= bytes[victim];
+            delete loaders[victim];
+            loaders[victim] = NULL;
+            table[victim] = NULL;
+            bytes[victim] = 0;
+            evictions++;
+        }
+    }
+
+    size_t nresident(){
+        return residentlist.size();
+    }
+
+    size_t size(){
+        return used;
+    }
+};
+
+#endif
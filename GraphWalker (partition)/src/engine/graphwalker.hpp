@@ -11,15 +11,17 @@
 #include <assert.h>
 #include <omp.h>
 #include <vector>
-#include <map>
 #include <sys/time.h>
 
 #include "api/filename.hpp"
 #include "api/io.hpp"
+#include "api/csrblock.hpp"
 #include "logger/logger.hpp"
 #include "metrics/metrics.hpp"
 #include "api/pthread_tools.hpp"
 #include "walks/randomwalk.hpp"
+#include "engine/prefetcher.hpp"
+#include "engine/blockcache.hpp"
 
 class graphwalker_engine {
 public:     
@@ -32,7 +34,11 @@ public:
     
     /* State */
     int exec_block;
-    std::map<vid_t, int> imap;
+    /* Resident blocks, and the block being loaded ahead */
+    blockCache *cache;
+    blockLoader *prefetch_loader;
+    blockPrefetcher *prefetcher;
+    size_t prefetch_hits, prefetch_misses;
     
     /* Metrics */
     metrics &m;
@@ -45,8 +51,12 @@ public:
         logstream(LOG_INFO) << "Engine configuration: " << std::endl;
         logstream(LOG_INFO) << " exec_threads = " << exec_threads << std::endl;
         // logstream(LOG_INFO) << " load_threads = " << load_threads << std::endl;
-        logstream(LOG_INFO) << " membudget_mb = " << membudget_mb << std::endl;
+        logstream(LOG_INFO) << " membudget_mb = " << membudget_mb << " (block cache)" << std::endl;
         logstream(LOG_INFO) << " blocksize = " << blocksize << std::endl;
+        logstream(LOG_INFO) << " spill walks per block = " << walk_manager->spillwalks << std::endl;
+        logstream(LOG_INFO) << " prefetch = " << (prefetcher != NULL) << std::endl;
+        logstream(LOG_INFO) << " walk bits = " << 8 * sizeof(WalkDataType) << " (source " << walk_encoding::SOURCE_BITS
+            << ", aux " << walk_encoding::AUX_BITS << ", hop " << walk_encoding::HOP_BITS << ")" << std::endl;
         // logstream(LOG_INFO) << " scheduler = " << use_selective_scheduling << std::endl;
     }
         
@@ -55,74 +65,130 @@ public:
     /**
      * Initialize GraphChi engine
      * @param base_filename prefix of the graph files
-     * @param nshards number of shards
-     * @param selective_scheduling if true, uses selective scheduling 
+     * @param nblocks number of blocks
+     * @param nvertices number of vertices
+     * @param bidx block index of every vertex
      */
-    graphwalker_engine(std::string _base_filename, int _nblocks, metrics &_m) : base_filename(_base_filename), nblocks(_nblocks), m(_m) {
+    graphwalker_engine(std::string _base_filename, int _nblocks, int _nvertices, const blockMap *bidx, metrics &_m) : base_filename(_base_filename), nblocks(_nblocks), nvertices(_nvertices), m(_m) {
 
         membudget_mb = get_option_int("membudget_mb", 1024);
         exec_threads = get_option_int("execthreads", omp_get_max_threads());
 
+        if ((uint64_t)nvertices > walk_encoding::max_vertices()) {
+            logstream(LOG_FATAL) << "Graph has " << nvertices << " vertices, but " << 8 * sizeof(WalkDataType)
+                << "-bit walks can only address " << walk_encoding::max_vertices() << ". Rebuild with WALK64=1." << std::endl;
+        }
+        assert((uint64_t)nvertices <= walk_encoding::max_vertices());
+        if ((size_t)nvertices > bidx->nvertices()) {
+            logstream(LOG_FATAL) << "Block map only covers " << bidx->nvertices() << " of " << nvertices << " vertices." << std::endl;
+        }
+        assert((size_t)nvertices <= bidx->nvertices());
+
         walk_manager = new walkManager(m);
-        walk_manager->initialnizeWalks(nblocks, nvertices, base_filename);
+        walk_manager->initialnizeWalks(nblocks, nvertices, exec_threads, bidx, base_filename, (size_t)get_option_int("walkbudget_mb", 0) * 1024 * 1024);
+        cache = new blockCache(nblocks, (size_t)membudget_mb * 1024 * 1024, get_option_int("mmap", 0) == 1);
+        prefetch_loader = NULL;
+        prefetcher = get_option_int("prefetch", 0) == 1 ? new blockPrefetcher() : NULL;
+        prefetch_hits = prefetch_misses = 0;
     }
         
     virtual ~graphwalker_engine() {
+        if (prefetcher != NULL) delete prefetcher;
+        delete walk_manager;
+        if (prefetch_loader != NULL) delete prefetch_loader;
+        delete cache;
     }
 
-    void loadBlock(int p, std::vector<Vertex> &vertices ){
-        std::string bname = blockname( base_filename, p );
-        int inf = open(bname.c_str(),O_RDONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-        if (inf < 0) {
-          logstream(LOG_FATAL) << "Could not load :" << base_filename << " error: " << strerror(errno) << std::endl;
-        }
-        assert(inf > 0);
-        char * buf;
-        size_t sz = readfull(inf, &buf);
-        char * bufptr = buf;
-        int vcnt = sz / sizeof(int);
-        int cnt = 0;
-        vertices.clear();
-        imap.clear();
-        while( vcnt > 0 ){
-          Vertex v;
-          v.vid = *((int*)bufptr);
-          bufptr += sizeof(int);
-          int dcnt = *((int*)bufptr);
-          bufptr += sizeof(int);
-          v.outd = dcnt;
-          for( int i = 0; i < v.outd; i++ ){
-              vid_t to = *((vid_t*)bufptr);
-              bufptr += sizeof(vid_t);
-              v.outv.push_back(to);
-          }
-          vertices.push_back(v);
-          imap[v.vid] = cnt;
-          cnt++;
-          vcnt -= (v.outd + 2);
+    void loadBlock(int p){
+        metrics_entry me = m.start_time();
+        blockLoader *loader = cache->newLoader();
+        size_t sz = loader->load(blockname( base_filename, p ));
+        cache->insert(p, loader, sz);
+        m.stop_time(me, "_load-block");
+        m.add("block_loads", 1);
+        m.add("block_bytes_read", (double)sz);
+        walk_manager->stats.loaded(p, sz);
+    }
+
+    /**
+     * Waits for the block loaded ahead and puts it into the cache.
+     * @return the prefetched block, -1 if none was requested
+     */
+    int completePrefetch(){
+        if (prefetcher == NULL || prefetcher->block < 0) return -1;
+        metrics_entry me = m.start_time();
+        prefetcher->wait();
+        m.stop_time(me, "_wait-prefetch");
+        m.add("block_loads", 1);
+        m.add("block_bytes_read", (double)prefetcher->bytes);
+        m.add("prefetch_load_time", prefetcher->loadtime);
+        int p = prefetcher->block;
+        walk_manager->stats.loaded(p, prefetcher->bytes);
+        prefetcher->reset();
+        cache->insert(p, prefetch_loader, prefetcher->bytes);
+        prefetch_loader = NULL;
+        return p;
+    }
+
+    /**
+     * Makes block p resident, from the cache, the prefetcher or the disk,
+     * and evicts other blocks if the memory budget is exceeded.
+     */
+    void acquireBlock(int p){
+        /* Collect the prefetch first, so a prefetched block does not count as a cache miss */
+        int prefetched = completePrefetch();
+        if (prefetched >= 0) {
+            if (prefetched == p) prefetch_hits++;
+            else prefetch_misses++;
         }
-        free(buf);
-        close(inf);
+        if (prefetched != p && cache->use(p) == NULL)
+            loadBlock(p);
+        cache->evict(*walk_manager, p);
     }
 
-    virtual void exec_updates(RandomWalkProgram &userprogram, std::vector<Vertex> &vertices) {
+    /**
+     * Starts loading the predicted next block in the background. Called
+     * after the walks of the exec block were taken out, so the block with
+     * the most walks is the runner-up of the current round.
+     */
+    void prefetchNext(){
+        int next = walk_manager->intervalWithMaxWalks();
+        if (next == exec_block || walk_manager->getWalksDis(next) == 0 || cache->resident(next)) return;
+        prefetch_loader = cache->newLoader();
+        prefetcher->start(prefetch_loader, next, blockname( base_filename, next ));
+    }
+
+    virtual void exec_updates(RandomWalkProgram &userprogram, std::vector<walkBuffer::chunk*> &chunks) {
+        metrics_entry me = m.start_time();
         omp_set_num_threads(exec_threads);
-        unsigned nv = (unsigned)(vertices.size());
-        #pragma omp parallel for
-            for( unsigned i = 0; i < nv; i++ ){
-                userprogram.updateByWalk(vertices, i, exec_block, imap, *walk_manager);
+        int nchunks = (int)chunks.size();
+        #pragma omp parallel for schedule(dynamic, 1)
+            for( int i = 0; i < nchunks; i++ ){
+                int t = omp_get_thread_num();
+                walkBuffer::chunk *c = chunks[i];
+                for( unsigned j = 0; j < c->size; j++ )
+                    userprogram.updateByWalk(c->walks[j], t, *cache, exec_block, *walk_manager);
             }
+        walkBuffer::freeChunks(chunks);
+        m.stop_time(me, "_exec-updates");
+        walk_manager->stats.execDone(exec_block);
+        walk_manager->mergeLocalWalks();
     }
 
-    void walkToEnd(RandomWalkProgram &userprogram, std::vector<Vertex> &vertices){
-        exec_updates(userprogram, vertices);
+    void walkToEnd(RandomWalkProgram &userprogram, std::vector<walkBuffer::chunk*> &chunks){
+        exec_updates(userprogram, chunks);
     }
 
     void runInterval(RandomWalkProgram &userprogram){
         /* Load data */
-        std::vector<Vertex> vertices;
-        loadBlock(exec_block, vertices);
-        walkToEnd(userprogram, vertices);
+        acquireBlock(exec_block);
+        /* Walks spilled to disk come back in batches of bounded size */
+        std::vector<walkBuffer::chunk*> chunks;
+        while (walk_manager->getWalks(exec_block, chunks) > 0) {
+            if (prefetcher != NULL && prefetcher->block < 0 && walk_manager->getWalksDis(exec_block) == 0)
+                prefetchNext();
+            walkToEnd(userprogram, chunks);
+        }
     }
 
     void loadOnDemand(RandomWalkProgram &userprogram){
@@ -132,7 +198,7 @@ public:
         /* -- move walks -- Rui */
         while( walk_manager->notFinish() ){
             exec_block =walk_manager->intervalWithMaxWalks();
-            //walk_manager->printWalksDistribution( exec_interval );
+            walk_manager->stats.sample(walk_manager->walknum);
             metrics_entry mr = m.start_time();
             runInterval(userprogram);
             m.stop_time(mr, "_in_run_interval");
@@ -141,8 +207,25 @@ public:
 
     void run(RandomWalkProgram &userprogram) {
         // initialize_before_run();
+        m.start_time("runtime");
         userprogram.startWalks(*walk_manager);
         loadOnDemand(userprogram);
+        m.stop_time("runtime");
+
+        /* A prediction still in flight when the walks finish is neither hit nor miss */
+        if (prefetcher != NULL) {
+            completePrefetch();
+            m.set("prefetch_hits", prefetch_hits);
+            m.set("prefetch_misses", prefetch_misses);
+            if (prefetch_hits + prefetch_misses > 0)
+                m.set("prefetch_hit_rate", (double)prefetch_hits / (prefetch_hits + prefetch_misses));
+        }
+        m.set("cache_hits", cache->hits);
+        m.set("cache_misses", cache->misses);
+        m.set("cache_evictions", cache->evictions);
+        m.set("cache_resident_blocks", cache->nresident());
+        m.set("walks_spilled", (double)walk_manager->spilled);
+        walk_manager->stats.report(m);
     }
 };
 
@@ -0,0 +1,91 @@
+#ifndef DEF_GRAPHWALKER_PREFETCHER
+#define DEF_GRAPHWALKER_PREFETCHER
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "api/csrblock.hpp"
+#include "api/pthread_tools.hpp"
+
+/**
+ * Background thread that loads one block ahead into a spare loader
+ * while the engine walks the current block. The thread does not touch
+ * the metrics; the engine reads bytes and load time after wait().
+ */
+class blockPrefetcher
+{
+private:
+    pthread_t thread;
+    mutex lock;
+    conditional cond;
+    bool pending, stop;
+    blockLoader *target;
+    std::string bname;
+
+public:
+    int block;          // block requested by the last start(), -1 if none
+    size_t bytes;
+    double loadtime;
+
+    blockPrefetcher() : pending(false), stop(false), target(NULL), block(-1), bytes(0), loadtime(0) {
+        int err = pthread_create(&thread, NULL, run, this);
+        assert(err == 0);
+    }
+
+    ~blockPrefetcher() {
+        lock.lock();
+        stop = true;
+        cond.broadcast();
+        lock.unlock();
+        pthread_join(thread, NULL);
+    }
+
+    /* Starts loading block p into loader. */
+    void start( blockLoader *loader, int p, std::string name ){
+        lock.lock();
+        assert(!pending);
+        target = loader;
+        block = p;
+        bname = name;
+        pending = true;
+        cond.broadcast();
+        lock.unlock();
+    }
+
+    /* Waits until the requested block is in memory. */
+    void wait(){
+        lock.lock();
+        while( pending ) cond.wait(lock);
+        lock.unlock();
+    }
+
+    void reset(){
+        block = -1;
+    }
+
+private:
+    static void *run( void *arg ){
+        blockPrefetcher *self = (blockPrefetcher*)arg;
+        self->lock.lock();
+        while( true ){
+            while( !self->pending && !self->stop ) self->cond.wait(self->lock);
+            if( self->stop ) break;
+            self->lock.unlock();
+
+            timeval st, en;
+            gettimeofday(&st, NULL);
+            size_t sz = self->target->load(self->bname);
+            gettimeofday(&en, NULL);
+
+            self->lock.lock();
+            self->bytes = sz;
+            self->loadtime = en.tv_sec - st.tv_sec + ((double)(en.tv_usec - st.tv_usec)) / 1.0E6;
+            self->pending = false;
+            self->cond.broadcast();
+        }
+        self->lock.unlock();
+        return NULL;
+    }
+};
+
+#endif
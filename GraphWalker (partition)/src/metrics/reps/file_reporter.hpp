@@ -93,6 +93,12 @@
                       fprintf(f, "%s.%s=%s\n", ident.c_str(), it->first.c_str(), it->second.stringval.c_str());                                
                       break;
                   case VECTOR:
+                      fprintf(f, "%s.%s=%lf\n", ident.c_str(), it->first.c_str(),  (ent.value));
+                      fprintf(f, "%s.%s.count=%lu\n", ident.c_str(), it->first.c_str(), ent.count);
+                      fprintf(f, "%s.%s.values=", ident.c_str(), it->first.c_str());
+                      for(size_t j = 0; j < ent.v.size(); j++)
+                          fprintf(f, j == 0 ? "%lg" : ",%lg", ent.v[j]);
+                      fprintf(f, "\n");
                       break;
               }
           }
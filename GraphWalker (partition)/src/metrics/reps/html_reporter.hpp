@@ -132,7 +132,15 @@
                                 break;
                             case VECTOR:
                                 if (round == 3) {
-                                    // TODO
+                                    if (c++ == 0)
+                                        fprintf(f, "<table><tr><th>Key</th><th>Sum</th><th>Count</th><th>Values</th></tr>\n");
+                                    fprintf(f, "<tr><td>%s</td>\n",  it->first.c_str());
+                                    fprintf(f, "<td>%lf</td>\n",  ent.value);
+                                    fprintf(f, "<td>%ld</td>\n", (long int) ent.count);
+                                    fprintf(f, "<td width=400>");
+                                    for(size_t j = 0; j < ent.v.size(); j++)
+                                        fprintf(f, j == 0 ? "%lg" : ", %lg", ent.v[j]);
+                                    fprintf(f, "</td></tr>");
                                 }
                                 break;
                         }
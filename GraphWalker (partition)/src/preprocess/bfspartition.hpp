@@ -1,137 +1,87 @@
-
 #ifndef BFSPARTITION
 #define BFSPARTITION
 
 #include <queue>
+#include <omp.h>
 
-#include "preprocess/simpartition.hpp"
+#include "api/cmdopts.hpp"
+#include "preprocess/csrconverter.hpp"
+#include "api/csrblock.hpp"
+#include "api/blockmap.hpp"
 
+/**
+ * Cuts the graph into blocks of vertices that are close to each other.
+ * Every thread grows its own blocks by a breadth-first search over the
+ * mapped CSR graph and claims vertices with a compare-and-swap, so the
+ * blocks are disjoint. A search restarts from the smallest unclaimed
+ * vertex when its frontier runs dry, and a full block is continued from
+ * the remaining frontier. For a weighted graph every block carries the
+ * alias tables of its vertices, so walks pick an out-edge by weight in
+ * constant time. With reverse every block also carries the in-edges of its
+ * vertices, so walks that step along in-edges need no second set of
+ * blocks.
+ */
 class BfsPartition
 {
 private:
     std::string filename;
     int nvertices;
-    std::vector<std::pair<vid_t, vid_t>> invls;
-    int invlnum;
-    int curinvl;
-    int invlsize;
     int blockid;
     int blocksize;
-    int cursize;
-    int membudget_mb;
-    std::vector<Vertex> vertices;
-    bool *visited;
+    int nthreads;
+    bool weighted;
+    bool reverse;
+    /* Block of every vertex during partitioning, -1 if not yet claimed */
+    std::vector<int> owner;
+    /* Vertices of every block, indexed by the block id handed out during the search */
+    std::vector< std::vector<vid_t> > blocks;
+    int nextblock;
+    vid_t nextseed;
 public:
-    BfsPartition(std::string inputfile){
+    BfsPartition(std::string inputfile, bool _weighted = false, bool _reverse = false){
         filename = inputfile;
+        weighted = _weighted;
+        reverse = _reverse;
     };
     ~BfsPartition(){};
 
     void computeBlocksize(){
-        membudget_mb = 800;
-        invlsize = 10*1024 * 1024 ;
-        blocksize  = 10*1024 * 1024 ;
-    }
-
-    int findInvl( vid_t u ){
-        for( int i = 0; i < invlnum; i++)
-            if( u <= invls[i].second )
-                return i;
-        return -1;
+        /* Blocks of blocksize_kb, counted in ints */
+        blocksize = get_option_int("blocksize_kb", 40 * 1024) * (1024 / sizeof(int));
     }
 
-    int find_partition(char *bidx){
-        int p = 0;
-        std::string bname = blockname( filename, p );
-        int inf = open(bname.c_str(),O_RDONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-        while (inf > 0) {
-            char * buf;
-            size_t sz = readfull(inf, &buf);
-            char * bufptr = buf;
-            int vcnt = sz / sizeof(int);
-            int cnt = 0;
-            while( vcnt > 0 ){
-                vid_t vv = *((int*)bufptr);
-                *(bidx+vv) = (char)p;
-                bufptr += sizeof(int);
-                int dcnt = *((int*)bufptr);
-                bufptr += sizeof(int);
-                bufptr += sizeof(vid_t)*dcnt;
-                cnt++;
-                vcnt -= (dcnt + 2);
-            }
-        free(buf);
-        close(inf);
-        bname = blockname( filename, ++p );
-        inf = open(bname.c_str(),O_RDONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-        }
-        close(inf);
-        return p;
+    static time_t mtime( std::string fname ){
+        struct stat st;
+        if( stat(fname.c_str(), &st) != 0 ) return 0;
+        return st.st_mtime;
     }
 
-    void loadInvl(int p){
-        // std::cout << " load interval " << p << " start ." << std::endl; 
-        std::string invlname = intervalname( filename, p );
-        int inf = open(invlname.c_str(),O_RDONLY | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-        if (inf < 0) {
-            logstream(LOG_FATAL) << "Could not load :" << filename << " error: " << strerror(errno) << std::endl;
+    /**
+     * Maps the block map of an earlier partitioning. It is used if it was
+     * made with the current block size after the last change of the graph,
+     * all of its block files are present and they have alias tables exactly
+     * if the graph is weighted and in-edges exactly if they are asked for.
+     * @return number of blocks, 0 if the graph has to be partitioned
+     */
+    int find_partition( blockMap &bidx ){
+        std::string mapname = bidxname(filename);
+        if( mtime(mapname) < mtime(filename) || !bidx.load(mapname) ) return 0;
+        if( bidx.blocksize() != (size_t)blocksize ){
+            bidx.release();
+            return 0;
         }
-        assert(inf > 0);
-        char * buf;// = (char*) malloc(invlsize*sizeof(int));
-        size_t sz = readfull(inf, &buf);
-        char * bufptr = buf;
-        int vcnt = sz / sizeof(int);
-        int curvertex = invls[p].first;
-        vertices.clear();
-        while( vcnt > 0 ){
-            Vertex v;
-            v.vid = curvertex;
-            int dcnt = *((int*)bufptr);
-            // if( curvertex < 10 ) std::cout << curvertex << " d: " << *((int*)bufptr) << " : ";
-            bufptr += sizeof(int);
-            v.outd = dcnt;
-            for( int i = 0; i < v.outd; i++ ){
-                vid_t to = *((vid_t*)bufptr);
-                // if( curvertex < 10 ) std::cout << *((int*)bufptr) << "  ";
-                bufptr += sizeof(vid_t);
-                v.outv.push_back(to);
+        for( int p = 0; p < bidx.nblocks(); p++ )
+            if( access(blockname(filename, p).c_str(), F_OK) != 0 ){
+                bidx.release();
+                return 0;
             }
-            // if( curvertex < 10 )  std::cout << std::endl;
-            vertices.push_back(v);
-            curvertex++;
-            vcnt -= (v.outd + 1);
-            /*if( p == 1 ){
-                for( unsigned i = 0; i < vertices.size(); i++ ){
-                    std::cout << vertices[i].vid << " " << vertices[i].outd << " : " << std::endl;
-                    for( int j = 0; j < vertices[i].outd; j++ )
-                        std::cout << vertices[i].outv[j] << " ";
-                    std::cout << std::endl;
-                }
-            }*/
+        csrBlockHeader hdr;
+        if( bidx.nblocks() > 0 && (!read_csr_header(blockname(filename, 0), hdr) || ((hdr.flags & CSRBLOCK_ALIAS) != 0) != weighted
+                || ((hdr.flags & CSRBLOCK_REVERSE) != 0) != reverse) ){
+            bidx.release();
+            return 0;
         }
-        free(buf);
-        close(inf);
-        // std::cout << " load interval " << p << " end ." << std::endl; 
-        // std::cout << p << "  " << vertices.size() << std::endl; 
-    }
-
-    bool add_vertex(char * buf, char * &bufptr, Vertex v){
-        if( cursize + v.outd + 2 > blocksize ){
-            std::string bname = blockname(filename,blockid);
-            writefile(bname, buf, bufptr);
-            std::cout << blockid << " " << cursize << std::endl;
-            blockid++;
-            cursize = 0;
-            return false;
-        }
-        *((int*)bufptr) = v.outd;
-        bufptr += sizeof(int);
-        for( int i = 0; i < v.outd; i++ ){
-            *((vid_t*)bufptr) = v.outv[i];
-            bufptr += sizeof(vid_t);
-        }
-        cursize += v.outd + 2;
-        return true;
+        return bidx.nblocks();
     }
 
     struct cmp{
@@ -140,67 +90,115 @@ public:
         }
     };
 
-    void bfs( char * buf, char * &bufptr, vid_t u, char *bidx ){
-        // std::queue<vid_t> Q;
+    /* Returns the smallest vertex that may still be unclaimed, nvertices when done. */
+    vid_t nextSeed(){
+        vid_t u;
+        do{
+            u = __sync_fetch_and_add(&nextseed, 1);
+        }while( u < (vid_t)nvertices && owner[u] >= 0 );
+        return u < (vid_t)nvertices ? u : nvertices;
+    }
+
+    /**
+     * Search of one thread; the block size counts ints like the block files,
+     * three per edge with the alias tables of a weighted graph, plus one
+     * per in-edge and vertex with the in-edges.
+     * The finished blocks are returned in done, as the block table is only
+     * filled in after all threads are finished.
+     */
+    void bfs( const csrBlock &graph, std::vector< std::pair< int, std::vector<vid_t> > > &done ){
         std::priority_queue< vid_t, std::vector<vid_t>, cmp > Q;
-        Q.push( u );
-        while( !Q.empty() ){
-            // vid_t u = Q.front();
+        std::vector<vid_t> members;
+        int b = -1, cursize = 0;
+        int edgesize = weighted ? 3 : 1;
+        while( true ){
+            if( Q.empty() ){
+                vid_t seed = nextSeed();
+                if( seed == (vid_t)nvertices ) break;
+                Q.push(seed);
+            }
             vid_t u = Q.top();
             Q.pop();
-            if(visited[u])  continue;
-            visited[u] = true;
-            int p = findInvl(u);
-            if( p != curinvl ) { 
-                loadInvl(p);
-                curinvl = p;
-                std::cout << u << " " << p << "  " << vertices.size() << " " << cursize << std::endl; 
-            }
-            Vertex v = vertices[u-invls[curinvl].first];
-            if( !add_vertex(buf, bufptr, v) ) return ;
-            *(bidx+v.vid) = (char)blockid;
-            for( int i = 0; i < v.outd; i++ ){
-                vid_t to = v.outv[i];
-                if(!visited[to] ){
-                    Q.push(to);
-                }
+            if( owner[u] >= 0 ) continue;
+            int vsize = graph.outd(u) * edgesize + 2 + (reverse ? graph.ind(u) + 1 : 0);
+            if( cursize > 0 && cursize + vsize > blocksize ){
+                done.push_back(std::make_pair(b, std::vector<vid_t>()));
+                done.back().second.swap(members);
+                b = -1;
+                cursize = 0;
             }
+            if( b < 0 ) b = __sync_fetch_and_add(&nextblock, 1);
+            if( !__sync_bool_compare_and_swap(&owner[u], -1, b) ) continue;
+            members.push_back(u);
+            cursize += vsize;
+            int outd = graph.outd(u);
+            const vid_t *outv = graph.outv(u);
+            for( int i = 0; i < outd; i++ )
+                if( owner[outv[i]] < 0 )
+                    Q.push(outv[i]);
+        }
+        if( b >= 0 ){
+            done.push_back(std::make_pair(b, std::vector<vid_t>()));
+            done.back().second.swap(members);
         }
     }
 
-    vid_t minNotVisitedVertex( vid_t j ){
-        for (int i = j; i < nvertices; ++i)
-            if( !visited[i] )
-                return i;
-        return -1;
-    }
+    /**
+     * Partitions the graph into blocks unless an earlier partitioning can
+     * be reused, and maps the vertex to block map into bidx.
+     * @return number of blocks
+     */
+    int partition( blockMap &bidx ){
+        computeBlocksize();
+        blockid = find_partition(bidx);
+        if( blockid > 0 ){
+            logstream(LOG_INFO) << "Using the " << blockid << " blocks of " << bidxname(filename) << std::endl;
+            return blockid;
+        }
+        nthreads = omp_get_max_threads();
+
+        CsrConverter converter(filename, weighted, reverse);
+        blockLoader graphloader(true);
+        graphloader.load(converter.convert());
+        const csrBlock &graph = graphloader.block;
+        nvertices = graph.nverts();
+        owner.assign(nvertices, -1);
+        nextblock = 0;
+        nextseed = 0;
+
+        std::vector< std::vector< std::pair< int, std::vector<vid_t> > > > done(nthreads);
+        #pragma omp parallel num_threads(nthreads)
+        bfs(graph, done[omp_get_thread_num()]);
+        blocks.assign(nextblock, std::vector<vid_t>());
+        for( int t = 0; t < nthreads; t++ )
+            for( unsigned i = 0; i < done[t].size(); i++ )
+                blocks[done[t][i].first].swap(done[t][i].second);
+        done.clear();
 
-    int partition( char **bidx ){
-        //
-        // blockid = find_partition(*bidx);
-        // if( blockid > 0 )  return blockid;
+        /* Searches that ran out of vertices may leave empty blocks behind */
+        std::vector<int> blockmap(blocks.size(), -1);
         blockid = 0;
+        for( unsigned b = 0; b < blocks.size(); b++ )
+            if( !blocks[b].empty() )
+                blockmap[b] = blockid++;
 
-        SimPartition sim_partition_obj(filename);
-        invls = sim_partition_obj.partition();
-        invlnum = invls.size();
-        nvertices = invls[invlnum-1].second + 1;
-        visited = (bool*)malloc(nvertices*sizeof(bool));
-        memset(visited, 0, nvertices);
-        computeBlocksize();
-        char * buf = (char*) malloc(blocksize*sizeof(int));
-        char * bufptr = buf;
         mkdir((filename+"_block/").c_str(), 0777);
-        curinvl = -1;
-        cursize = 0;
-        vid_t minnvv = 0;
-        while( minnvv >= 0 ){
-            bfs(buf, bufptr, minnvv, *bidx);
-            minnvv = minNotVisitedVertex( minnvv );
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(nthreads)
+        for( int b = 0; b < (int)blocks.size(); b++ ){
+            if( blockmap[b] < 0 ) continue;
+            for( unsigned i = 0; i < blocks[b].size(); i++ )
+                owner[blocks[b][i]] = blockmap[b];
+            write_csr_block(blockname(filename, blockmap[b]), graph, blocks[b]);
+            std::vector<vid_t>().swap(blocks[b]);
         }
+        write_block_map(bidxname(filename), owner, blockid, blocksize);
+        owner.clear();
+        blocks.clear();
+        logstream(LOG_INFO) << "Partitioned " << nvertices << " vertices into " << blockid << " blocks with " << nthreads << " threads." << std::endl;
+        if( !bidx.load(bidxname(filename)) ) assert(false);
         return blockid;
     }
-    
+
 };
 
-#endif
\ No newline at end of file
+#endif
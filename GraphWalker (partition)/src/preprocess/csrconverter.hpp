@@ -0,0 +1,168 @@
+#ifndef CSRCONVERTER
+#define CSRCONVERTER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+#include "logger/logger.hpp"
+#include "api/filename.hpp"
+#include "api/csrblock.hpp"
+
+/**
+ * Converts a text edge list, sorted by source vertex, into one binary CSR
+ * file in the block format. The edge list is parsed once; the partitioner
+ * and later runs work on the mapped CSR file, whose neighbor lists are
+ * sorted by id. For a weighted graph the
+ * third column of an edge is its weight, 1 if it is missing. With reverse
+ * the in-edges of every vertex are stored as well.
+ */
+class CsrConverter
+{
+private:
+    std::string filename;
+    bool weighted;
+    bool reverse;
+
+    static bool parse_vid( char *&s, vid_t &v ){
+        while( *s == ' ' || *s == '\t' || *s == ',' ) s++;
+        if( *s < '0' || *s > '9' ) return false;
+        uint64_t x = 0;
+        while( *s >= '0' && *s <= '9' ) x = x * 10 + (*s++ - '0');
+        v = (vid_t)x;
+        return true;
+    }
+
+    static bool parse_weight( char *&s, float &w ){
+        while( *s == ' ' || *s == '\t' || *s == ',' ) s++;
+        char *end;
+        w = strtof(s, &end);
+        if( end == s ) return false;
+        s = end;
+        return true;
+    }
+
+    /* Sorts every neighbor list, keeping the weights with their edges. */
+    static void sortNeighbors( const std::vector<uint32_t> &beg, std::vector<vid_t> &nbrs, std::vector<float> &weights ){
+        std::vector< std::pair<vid_t, float> > edges;
+        for( size_t v = 0; v + 1 < beg.size(); v++ ){
+            if( weights.empty() ){
+                std::sort(nbrs.begin() + beg[v], nbrs.begin() + beg[v+1]);
+                continue;
+            }
+            edges.clear();
+            for( uint32_t e = beg[v]; e < beg[v+1]; e++ )
+                edges.push_back(std::make_pair(nbrs[e], weights[e]));
+            std::sort(edges.begin(), edges.end());
+            for( uint32_t e = beg[v]; e < beg[v+1]; e++ ){
+                nbrs[e] = edges[e - beg[v]].first;
+                weights[e] = edges[e - beg[v]].second;
+            }
+        }
+    }
+
+    /* Transposes the sorted lists, which leaves the in-edges sorted by source. */
+    static void reverseEdges( const std::vector<uint32_t> &beg, const std::vector<vid_t> &nbrs, std::vector<uint32_t> &inbeg, std::vector<vid_t> &innbrs ){
+        inbeg.assign(beg.size(), 0);
+        for( size_t e = 0; e < nbrs.size(); e++ )
+            inbeg[nbrs[e] + 1]++;
+        for( size_t v = 0; v + 1 < inbeg.size(); v++ )
+            inbeg[v + 1] += inbeg[v];
+        std::vector<uint32_t> pos(inbeg.begin(), inbeg.end() - 1);
+        innbrs.resize(nbrs.size());
+        for( size_t v = 0; v + 1 < beg.size(); v++ )
+            for( uint32_t e = beg[v]; e < beg[v+1]; e++ )
+                innbrs[pos[nbrs[e]]++] = (vid_t)v;
+    }
+
+public:
+    CsrConverter(std::string inputfile, bool _weighted = false, bool _reverse = false){
+        filename = inputfile;
+        weighted = _weighted;
+        reverse = _reverse;
+    };
+    ~CsrConverter(){};
+
+    /* The CSR file is reused as long as it is newer than the edge list and has weights and in-edges if they are asked for. */
+    bool uptodate(){
+        struct stat in, out;
+        if( stat(csrname(filename).c_str(), &out) != 0 ) return false;
+        csrBlockHeader hdr;
+        if( !read_csr_header(csrname(filename), hdr) || ((hdr.flags & CSRBLOCK_WEIGHTS) != 0) != weighted
+            || ((hdr.flags & CSRBLOCK_REVERSE) != 0) != reverse ) return false;
+        if( stat(filename.c_str(), &in) != 0 ) return true;
+        return out.st_mtime >= in.st_mtime;
+    }
+
+    /* Returns the name of the CSR file. */
+    std::string convert(){
+        std::string outname = csrname(filename);
+        if( uptodate() ){
+            logstream(LOG_INFO) << "Using binary graph " << outname << std::endl;
+            return outname;
+        }
+        FILE * inf = fopen(filename.c_str(), "r");
+        if (inf == NULL) {
+            logstream(LOG_FATAL) << "Could not load :" << filename << " error: " << strerror(errno) << std::endl;
+        }
+        assert(inf != NULL);
+        logstream(LOG_INFO) << "Reading in edge list format!" << std::endl;
+
+        std::vector<uint32_t> beg;
+        std::vector<vid_t> nbrs;
+        std::vector<float> weights;
+        vid_t maxvid = 0;
+        char s[1024];
+        while(fgets(s, 1024, inf) != NULL) {
+            if (s[0] == '#') continue; // Comment
+            if (s[0] == '%') continue; // Comment
+
+            char *ptr = s;
+            vid_t from, to;
+            if ( !parse_vid(ptr, from) || !parse_vid(ptr, to) ) {
+                logstream(LOG_ERROR) << "Input file is not in right format. "
+                << "Expecting \"<from>\t<to>\". "
+                << "Current line: \"" << s << "\"\n";
+                assert(false);
+            }
+            float w = 1.0f;
+            if( weighted && parse_weight(ptr, w) && w < 0 ){
+                logstream(LOG_FATAL) << "Edge " << from << " -> " << to << " has negative weight " << w << "." << std::endl;
+                assert(false);
+            }
+            if( from == to ) continue;
+            if( from + 1 < beg.size() ){
+                logstream(LOG_FATAL) << "Edge list has to be sorted by source vertex, " << from << " appears after " << beg.size() - 1 << "." << std::endl;
+                assert(false);
+            }
+            while( beg.size() <= from ) beg.push_back((uint32_t)nbrs.size());
+            nbrs.push_back(to);
+            if( weighted ) weights.push_back(w);
+            if( to > maxvid ) maxvid = to;
+        }
+        fclose(inf);
+        assert( nbrs.size() <= 0xffffffffu );
+        /* Vertices after the last source only have in-edges */
+        while( beg.size() <= maxvid ) beg.push_back((uint32_t)nbrs.size());
+        beg.push_back((uint32_t)nbrs.size());
+        sortNeighbors(beg, nbrs, weights);
+
+        uint32_t nverts = (uint32_t)beg.size() - 1;
+        std::vector<vid_t> vids(nverts);
+        for( uint32_t i = 0; i < nverts; i++ ) vids[i] = i;
+        std::vector<uint32_t> inbeg;
+        std::vector<vid_t> innbrs;
+        if( reverse ) reverseEdges(beg, nbrs, inbeg, innbrs);
+        write_csr_file(outname, nverts ? &vids[0] : NULL, &beg[0], nbrs.empty() ? NULL : &nbrs[0], nverts,
+            (weighted ? CSRBLOCK_WEIGHTS : 0) | (reverse ? CSRBLOCK_REVERSE : 0), weights.empty() ? NULL : &weights[0], NULL,
+            inbeg.empty() ? NULL : &inbeg[0], innbrs.empty() ? NULL : &innbrs[0]);
+        logstream(LOG_INFO) << "Converted " << nverts << " vertices and " << nbrs.size() << " edges to " << outname << std::endl;
+        return outname;
+    }
+};
+
+#endif
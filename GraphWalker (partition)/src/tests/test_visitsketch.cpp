@@ -0,0 +1,111 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Checks the visit sketch of the personalized PageRank walks: estimates
+ * never fall below the true counts, and the top k are the most visited
+ * vertices whether they rise early or late, from one thread or many.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+
+#include "walks/visitsketch.hpp"
+
+static const int NV = 200;
+static const unsigned K = 10;
+
+/* Vertex v is visited count(v) times; the top K are spread over the ids */
+static uint32_t count( vid_t v ){
+    return (v * 37) % NV + 1;
+}
+
+/* The K vertices with the largest counts, most visited first */
+static std::vector< std::pair<vid_t, uint32_t> > truetopk(){
+    std::vector< std::pair<uint32_t, vid_t> > all;
+    for( vid_t v = 0; v < NV; v++ )
+        all.push_back(std::make_pair(count(v), v));
+    std::sort(all.begin(), all.end(), std::greater< std::pair<uint32_t, vid_t> >());
+    std::vector< std::pair<vid_t, uint32_t> > res;
+    for( unsigned i = 0; i < K; i++ )
+        res.push_back(std::make_pair(all[i].second, all[i].first));
+    return res;
+}
+
+/* exact: the sketch is wide enough to have no collisions among NV vertices */
+static void check( const visitSketch &sketch, bool exact, const char *what ){
+    for( vid_t v = 0; v < NV; v++ )
+        assert(sketch.estimate(v) >= count(v));
+    if( exact ){
+        std::vector< std::pair<vid_t, uint32_t> > top = sketch.topk();
+        assert(top == truetopk());
+    }
+    printf("%s: OK\n", what);
+}
+
+int main( int argc, char const *argv[] ){
+    unsigned wide = 1 << 16, narrow = 16;
+
+    /* Vertex by vertex: later vertices push earlier ones out of the top k */
+    visitSketch byvertex;
+    byvertex.init(wide, K);
+    for( vid_t v = 0; v < NV; v++ )
+        for( uint32_t i = 0; i < count(v); i++ )
+            byvertex.visit(v);
+    check(byvertex, true, "visits by vertex");
+
+    /* Round robin: every vertex climbs a step at a time and entries move within the heap */
+    visitSketch roundrobin;
+    roundrobin.init(wide, K);
+    for( uint32_t r = 0; r < NV; r++ )
+        for( vid_t v = 0; v < NV; v++ )
+            if( count(v) > r ) roundrobin.visit(v);
+    check(roundrobin, true, "visits round robin");
+
+    /* Many threads at once */
+    visitSketch parallel;
+    parallel.init(wide, K);
+    std::vector<vid_t> visits;
+    for( vid_t v = 0; v < NV; v++ )
+        for( uint32_t i = 0; i < count(v); i++ )
+            visits.push_back(v);
+    srand(5);
+    for( int i = (int)visits.size() - 1; i > 0; i-- )
+        std::swap(visits[i], visits[rand() % (i + 1)]);
+    #pragma omp parallel for num_threads(8)
+    for( int i = 0; i < (int)visits.size(); i++ )
+        parallel.visit(visits[i]);
+    check(parallel, true, "parallel visits");
+
+    /* A narrow sketch overestimates but never underestimates */
+    visitSketch collisions;
+    collisions.init(narrow, K);
+    for( int i = 0; i < (int)visits.size(); i++ )
+        collisions.visit(visits[i]);
+    check(collisions, false, "narrow sketch");
+    std::vector< std::pair<vid_t, uint32_t> > top = collisions.topk();
+    assert(top.size() == K);
+    for( unsigned i = 1; i < top.size(); i++ )
+        assert(top[i - 1].second >= top[i].second);
+
+    /* Without a top k only the counts are kept */
+    visitSketch nok;
+    nok.init(wide, 0);
+    for( int i = 0; i < (int)visits.size(); i++ )
+        nok.visit(visits[i]);
+    assert(nok.topk().empty());
+    check(nok, false, "no top k");
+
+    /* init starts over */
+    byvertex.init(wide, K);
+    assert(byvertex.topk().empty());
+    assert(byvertex.estimate(0) == 0);
+
+    printf("Visit sketch test passed.\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Records walks from several threads in scrambled order, with some walks
+ * ending early and some never started, and checks that walkPathWriter
+ * writes every path in walk id order, in both formats. The memory
+ * budget is small, so the steps are spread over many buckets and every
+ * thread flushes several times.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <omp.h>
+
+#include "walks/walkpaths.hpp"
+
+static const uint32_t NWALKS = 200000;
+static const unsigned NSTEPS = 6;
+static const int NTHREADS = 4;
+
+/* Vertices on the path of walk id: walks with id % 7 == 3 stop after id % NSTEPS hops, id % 101 == 0 never start */
+static unsigned pathlength( uint32_t id ){
+    if( id % 101 == 0 ) return 0;
+    if( id % 7 == 3 ) return id % NSTEPS + 1;
+    return NSTEPS + 1;
+}
+
+/* Vertex of walk id at hop */
+static vid_t vertex( uint32_t id, unsigned hop ){
+    return (vid_t)((id * 2654435761u) ^ (hop * 40503u)) % 1000003;
+}
+
+static void record_all( walkPathWriter &writer ){
+    /* Hop by hop like the engine, each thread taking walks in its own order */
+    for( unsigned hop = 0; hop <= NSTEPS; hop++ ){
+        #pragma omp parallel for num_threads(NTHREADS) schedule(static)
+        for( int i = 0; i < (int)NWALKS; i++ ){
+            uint32_t id = (uint32_t)(((uint64_t)i * 7919) % NWALKS);
+            if( hop < pathlength(id) )
+                writer.record(omp_get_thread_num(), id, hop, vertex(id, hop));
+        }
+    }
+}
+
+static void check_binary( std::string outname ){
+    FILE *f = fopen(outname.c_str(), "rb");
+    assert(f != NULL);
+    std::vector<vid_t> path(NSTEPS + 1);
+    for( uint32_t id = 0; id < NWALKS; id++ ){
+        uint32_t len;
+        assert(fread(&len, sizeof(len), 1, f) == 1);
+        assert(len == pathlength(id));
+        assert(fread(&path[0], sizeof(vid_t), len, f) == len);
+        for( unsigned hop = 0; hop < len; hop++ )
+            assert(path[hop] == vertex(id, hop));
+    }
+    uint32_t extra;
+    assert(fread(&extra, sizeof(extra), 1, f) == 0);
+    fclose(f);
+}
+
+static void check_text( std::string outname ){
+    FILE *f = fopen(outname.c_str(), "r");
+    assert(f != NULL);
+    char line[256];
+    for( uint32_t id = 0; id < NWALKS; id++ ){
+        assert(fgets(line, sizeof(line), f) != NULL);
+        std::string expected;
+        for( unsigned hop = 0; hop < pathlength(id); hop++ ){
+            char buf[32];
+            sprintf(buf, hop == 0 ? "%u" : " %u", (unsigned)vertex(id, hop));
+            expected += buf;
+        }
+        expected += "\n";
+        assert(expected == line);
+    }
+    assert(fgets(line, sizeof(line), f) == NULL);
+    fclose(f);
+}
+
+int main( int argc, char const *argv[] ){
+    std::string dir = "/tmp/graphwalker_pathtest";
+    mkdir(dir.c_str(), 0777);
+    std::string base = dir + "/graph";
+    /* About 3000 walks per bucket */
+    size_t membudget = 3000 * (NSTEPS + 1) * sizeof(vid_t);
+
+    {
+        walkPathWriter writer(base, walkPathWriter::FORMAT_BINARY, NWALKS, NSTEPS, NTHREADS, membudget);
+        record_all(writer);
+        writer.write(dir + "/paths.bin");
+    }
+    check_binary(dir + "/paths.bin");
+    printf("Binary paths: OK\n");
+
+    {
+        walkPathWriter writer(base, walkPathWriter::FORMAT_TEXT, NWALKS, NSTEPS, NTHREADS, membudget);
+        record_all(writer);
+        writer.write(dir + "/paths.txt");
+    }
+    check_text(dir + "/paths.txt");
+    printf("Text paths: OK\n");
+
+    /* The bucket files are gone */
+    for( int b = 0; b < (int)(NWALKS / 3000 + 1); b++ ){
+        struct stat st;
+        assert(stat(pathsname(base, b).c_str(), &st) != 0);
+    }
+
+    /* Nothing recorded: one empty path per walk */
+    {
+        walkPathWriter writer(base, walkPathWriter::FORMAT_TEXT, 5, NSTEPS, 1, membudget);
+        writer.write(dir + "/empty.txt");
+    }
+    FILE *f = fopen((dir + "/empty.txt").c_str(), "r");
+    char line[16];
+    for( int i = 0; i < 5; i++ ){
+        assert(fgets(line, sizeof(line), f) != NULL);
+        assert(std::string(line) == "\n");
+    }
+    assert(fgets(line, sizeof(line), f) == NULL);
+    fclose(f);
+
+    remove((dir + "/paths.bin").c_str());
+    remove((dir + "/paths.txt").c_str());
+    remove((dir + "/empty.txt").c_str());
+    printf("Walk path test passed.\n");
+    return 0;
+}
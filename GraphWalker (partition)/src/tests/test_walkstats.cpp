@@ -0,0 +1,110 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Checks the walk metrics of walkStats: the log2 buckets of the walks per
+ * block histogram at their boundaries, the thinning of the snapshots in
+ * long runs, and the totals and per-block vectors handed to the metrics.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+#include <string>
+
+#include "walks/walkstats.hpp"
+
+static std::string histkey( long interval ){
+    char key[64];
+    sprintf(key, "walks_per_block_hist.%08ld", interval);
+    return key;
+}
+
+int main( int argc, char const *argv[] ){
+    set_argc(argc, argv);
+
+    /* Bucket 0 counts empty blocks, bucket k > 0 the blocks with 2^(k-1) to 2^k - 1 walks */
+    {
+        walkStats stats;
+        stats.init(12, 1);
+        int walks[] = { 0, 0, 1, 2, 3, 4, 7, 8, 15, 16, 1 << 29, 0x7fffffff };
+        stats.sample(std::vector<int>(walks, walks + 12));
+        metrics m("test_walkstats");
+        stats.report(m);
+        std::vector<double> h = m.get(histkey(0)).v;
+        double expected[32] = { 2, 1, 2, 2, 2, 1 };
+        expected[30] = 1;
+        expected[31] = 1;
+        assert(h.size() == 32);
+        for( int b = 0; b < 32; b++ ){
+            if( h[b] != expected[b] ) printf("Bucket %d: expected %g but had %g\n", b, expected[b], h[b]);
+            assert(h[b] == expected[b]);
+        }
+        /* Trailing empty buckets are dropped */
+        walkStats small;
+        small.init(3, 1);
+        int few[] = { 0, 1, 5 };
+        small.sample(std::vector<int>(few, few + 3));
+        metrics m2("test_walkstats");
+        small.report(m2);
+        assert(m2.get(histkey(0)).v.size() == 4);
+        printf("Histogram buckets: OK\n");
+    }
+
+    /* 200 samples: the period doubles at 64 and at 128 snapshots, leaving every fourth interval */
+    {
+        walkStats stats;
+        stats.init(4, 1);
+        std::vector<int> walknum(4, 1);
+        for( int i = 0; i < 200; i++ ){
+            walknum[i % 4] = i;
+            stats.sample(walknum);
+        }
+        metrics m("test_walkstats");
+        stats.report(m);
+        int snapshots = 0;
+        for( long i = 0; i < 200; i++ ){
+            bool kept = !m.get(histkey(i)).v.empty();
+            assert(kept == (i % 4 == 0));
+            snapshots += kept;
+        }
+        assert(snapshots == 50 && snapshots <= WALKSTATS_MAX_SNAPSHOTS);
+        printf("Histogram snapshots: OK\n");
+    }
+
+    /* Totals from several threads and the steps charged to the exec blocks */
+    {
+        walkStats stats;
+        stats.init(3, 2);
+        stats.loaded(0, 1000);
+        stats.walked(0, 5, true);
+        stats.walked(1, 3, false);
+        stats.jumped(1);
+        stats.execDone(0);
+        stats.loaded(2, 3000);
+        stats.walked(1, 4, true);
+        stats.execDone(2);
+        stats.loaded(0, 1000);
+        stats.walked(0, 8, false);
+        stats.execDone(0);
+        metrics m("test_walkstats");
+        stats.report(m);
+        assert(m.get("walk_steps").value == 20);
+        assert(m.get("walks_finished_in_block").value == 2);
+        assert(m.get("walks_crossed_blocks").value == 2);
+        assert(m.get("walks_jumped_blocks").value == 1);
+        assert(m.get("steps_per_load").value == 20.0 / 3);
+        assert(m.get("bytes_per_step").value == 5000.0 / 20);
+        double loads[] = { 2, 0, 1 }, steps[] = { 16, 0, 4 }, perload[] = { 8, 0, 4 };
+        for( int p = 0; p < 3; p++ ){
+            assert(m.get("per_block.loads").v[p] == loads[p]);
+            assert(m.get("per_block.steps").v[p] == steps[p]);
+            assert(m.get("per_block.steps_per_load").v[p] == perload[p]);
+        }
+        printf("Walk counters: OK\n");
+    }
+
+    printf("Walk stats test passed.\n");
+    return 0;
+}
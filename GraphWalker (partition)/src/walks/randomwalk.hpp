@@ -4,9 +4,17 @@
 #include <string>
 #include <fstream>
 #include <time.h>
+#include <math.h>
+#include <algorithm>
 
 #include "walks/walk.hpp" 
+#include "walks/walkrandom.hpp"
+#include "walks/visitsketch.hpp"
+#include "walks/walkpaths.hpp"
 #include "api/datatype.hpp"
+#include "api/csrblock.hpp"
+#include "engine/blockcache.hpp"
+#include "logger/logger.hpp"
 
 /**
  * Type definitions. Remember to create suitable graph shards using the
@@ -20,19 +28,200 @@ private:
     int nsteps;
     int nvertices;
     float boundRatio,  intervalBoundRatio;
-    char *bidx;
+    const blockMap *bidx;
+    uint32_t seed;
+    /* Personalized PageRank mode, on if alpha > 0: walk i starts at sources[i % sources.size()] */
+    float alpha;
+    std::vector<vid_t> sources;
+    visitSketch *sketches;
+    /* node2vec mode, on if secondorder: return parameter p and in-out parameter q */
+    bool secondorder;
+    float returnp, inoutq;
+    double maxbias;
+    /* Records the path of every walk if not NULL */
+    walkPathWriter *paths;
+    /* Edges a step follows, one of the DIRECTION_ policies; DIRECTION_RANDOM takes in-edges with probability inprob */
+    int direction;
+    float inprob;
 
 public:
     int degree;
     int count;
-    void initialization( int nv, int nw, int ns, float rb, float rbi, char *idx ) {
+    /* Stream of the start vertices, apart from the streams of the steps */
+    static const uint32_t START_STREAM = 1;
+    /* Start vertices are drawn this many at a time, so starting walks takes no O(nwalks) buffer */
+    static const int START_BATCH = 4096;
+    /* Streams of the proposals of second-order steps, one per proposal of a hop */
+    static const uint32_t PROPOSAL_STREAM = 2;
+    /* Steps along out-edges only, */
+    static const int DIRECTION_OUT = 0;
+    /* along in-edges only, */
+    static const int DIRECTION_IN = 1;
+    /* along out-edges at even hops and in-edges at odd hops, as in SALSA, */
+    static const int DIRECTION_ALTERNATE = 2;
+    /* or along in- or out-edges at random. */
+    static const int DIRECTION_RANDOM = 3;
+
+    void initialization( int nv, int nw, int ns, float rb, float rbi, const blockMap *idx, uint32_t sd ) {
         nvertices = nv;
         nwalks = nw;
         nsteps = ns;
         boundRatio = rb;
         intervalBoundRatio = rbi;
         std::cout << nv << " " << nw << " " << ns << " " << rb << " " << rbi << std::endl;
+        if ((unsigned)nsteps > walk_encoding::max_hop()) {
+            logstream(LOG_FATAL) << "Walks of " << nsteps << " steps do not fit into " << walk_encoding::HOP_BITS
+                << " hop bits. Rebuild with WALK64=1." << std::endl;
+        }
+        assert((unsigned)nsteps <= walk_encoding::max_hop());
         bidx = idx;
+        seed = sd;
+        alpha = 0;
+        sketches = NULL;
+        secondorder = false;
+        paths = NULL;
+        direction = DIRECTION_OUT;
+        inprob = 0;
+        logstream(LOG_INFO) << "Random walk seed : " << seed << std::endl;
+    }
+
+    ~RandomWalkProgram(){
+        if( sketches != NULL ) delete [] sketches;
+        if( paths != NULL ) delete paths;
+    }
+
+    /**
+     * Turns the walks into personalized PageRank walks: they start at the
+     * source vertices listed in seedfile, one id per line, and end with
+     * probability a at every step. Sinks return to the source. For every
+     * source, the topk most visited vertices are tracked in a sketch of
+     * width counters per row.
+     */
+    void initializePPR( float a, std::string seedfile, int topk, int width ){
+        std::ifstream ifs(seedfile.c_str());
+        if (!ifs.good()) {
+            logstream(LOG_FATAL) << "Could not load PPR seeds :" << seedfile << std::endl;
+        }
+        assert(ifs.good());
+        std::string line;
+        while( std::getline(ifs, line) ){
+            if( line.empty() || line[0] == '#' ) continue;
+            vid_t v = (vid_t)atol(line.c_str());
+            if( v >= (vid_t)nvertices ){
+                logstream(LOG_FATAL) << "PPR seed " << v << " is not a vertex of the graph." << std::endl;
+                assert(false);
+            }
+            sources.push_back(v);
+        }
+        if( sources.empty() ){
+            logstream(LOG_FATAL) << "No PPR seeds in " << seedfile << std::endl;
+            assert(false);
+        }
+        alpha = a;
+        sketches = new visitSketch[sources.size()];
+        for( unsigned i = 0; i < sources.size(); i++ )
+            sketches[i].init(width, topk);
+        logstream(LOG_INFO) << "PPR walks from " << sources.size() << " sources, alpha = " << alpha << std::endl;
+        /* A walk cut off at nsteps before it restarts biases the estimates towards the source */
+        double cut = pow(1.0 - alpha, nsteps);
+        if( cut > 0.01 ){
+            logstream(LOG_WARNING) << "A fraction " << cut << " of the PPR walks is cut off after " << nsteps
+                << " steps before it restarts. Raise nsteps to about " << (int)ceil(log(0.01) / log(1.0 - alpha)) << "." << std::endl;
+        }
+    }
+
+    /**
+     * Turns the walks into node2vec walks: a step from v, reached from u,
+     * goes back to u with weight 1/p, to a neighbor of u with weight 1
+     * and elsewhere with weight 1/q, times the edge weight. Steps are
+     * drawn by rejection from the first-order proposals.
+     */
+    void initializeNode2vec( float p, float q ){
+#ifndef GRAPHWALKER_SECOND_ORDER
+        logstream(LOG_FATAL) << "node2vec walks need the previous vertex in every walk. Rebuild with NODE2VEC=1." << std::endl;
+        assert(false);
+#endif
+        if( p <= 0 || q <= 0 ){
+            logstream(LOG_FATAL) << "node2vec parameters have to be positive, p = " << p << ", q = " << q << std::endl;
+            assert(false);
+        }
+        if( alpha > 0 ){
+            logstream(LOG_FATAL) << "node2vec walks cannot be personalized PageRank walks." << std::endl;
+            assert(false);
+        }
+        if( direction != DIRECTION_OUT ){
+            logstream(LOG_FATAL) << "node2vec walks only follow out-edges." << std::endl;
+            assert(false);
+        }
+        secondorder = true;
+        returnp = p;
+        inoutq = q;
+        maxbias = std::max(std::max(1.0 / p, 1.0), 1.0 / q);
+        logstream(LOG_INFO) << "node2vec walks, p = " << returnp << ", q = " << inoutq << std::endl;
+    }
+
+    /**
+     * Lets the steps follow in-edges as given by the policy dir, which
+     * needs blocks partitioned with their in-edges. Dead ends are handled
+     * as for out-edges.
+     * @param p probability of an in-edge step for DIRECTION_RANDOM
+     */
+    void initializeDirection( int dir, float p ){
+        if( dir == DIRECTION_RANDOM && (p < 0 || p > 1) ){
+            logstream(LOG_FATAL) << "Probability of in-edge steps has to be in [0, 1], got " << p << std::endl;
+            assert(false);
+        }
+        direction = dir;
+        inprob = p;
+    }
+
+    /* Whether the step at hop follows an in-edge; only DIRECTION_RANDOM draws from rng. */
+    bool inStep( int hop, walkRandom &rng ){
+        switch( direction ){
+            case DIRECTION_IN: return true;
+            case DIRECTION_ALTERNATE: return hop % 2 == 1;
+            case DIRECTION_RANDOM: return rng.uniform() < inprob;
+            default: return false;
+        }
+    }
+
+    /**
+     * Records the vertices visited by every walk, for writePaths.
+     * @param nthreads number of exec threads
+     * @param membudget bytes of paths reassembled at a time
+     */
+    void initializePaths( std::string base_filename, int format, int nthreads, size_t membudget ){
+        int startWalksNum = nwalks + nwalks*boundRatio;
+        paths = new walkPathWriter(base_filename, format, startWalksNum, nsteps, nthreads, membudget);
+    }
+
+    /* Writes one path per walk, in the order of the walk ids. */
+    void writePaths( std::string fname ){
+        paths->write(fname);
+    }
+
+    /* Top vertices of source i with their PPR estimates. */
+    std::vector< std::pair<vid_t, double> > topPPR( unsigned i ){
+        int startWalksNum = nwalks + nwalks*boundRatio;
+        long walks = startWalksNum / sources.size() + (i < startWalksNum % sources.size() ? 1 : 0);
+        std::vector< std::pair<vid_t, uint32_t> > top = sketches[i].topk();
+        std::vector< std::pair<vid_t, double> > res;
+        for( unsigned j = 0; j < top.size(); j++ )
+            res.push_back(std::make_pair(top[j].first, walks > 0 ? alpha * top[j].second / walks : 0.0));
+        return res;
+    }
+
+    /* Writes one line per source: the source followed by vertex:estimate pairs. */
+    void writePPR( std::string fname ){
+        std::ofstream ofs(fname.c_str());
+        for( unsigned i = 0; i < sources.size(); i++ ){
+            std::vector< std::pair<vid_t, double> > top = topPPR(i);
+            ofs << sources[i];
+            for( unsigned j = 0; j < top.size(); j++ )
+                ofs << "\t" << top[j].first << ":" << top[j].second;
+            ofs << std::endl;
+        }
+        ofs.close();
     }
 
     void startWalks( walkManager &walk_manager ){
@@ -41,53 +230,178 @@ public:
         int stopWalksNum = nwalks*boundRatio;
         walk_manager.getWalkNum(nwalks, stopWalksNum);
 
-        for( unsigned i = 0; i < walk_manager.walkscnt.size(); i++ ){
-            walk_manager.walkscnt[i] = 0;
-        }
-
-        srand((unsigned)time(NULL));
-        for( int i = 0; i < startWalksNum; i++ ){
-            vid_t s = rand() % nvertices;
-            WalkDataType walk = walk_manager.encode(s, 0);
-            walk_manager.addWalk(s, walk );
-            int p = (int)*(bidx+s);
-            walk_manager.walkscnt[p]++;
+        int batch = START_BATCH;
+        std::vector<uint32_t> bound(batch, nvertices), start(batch);
+        for( int first = 0; first < startWalksNum; first += batch ){
+            int n = std::min(batch, startWalksNum - first);
+            if( alpha <= 0 )
+                random_batch(seed, first, 0, START_STREAM, &bound[0], &start[0], n);
+            for( int j = 0; j < n; j++ ){
+                int i = first + j;
+                vid_t s = alpha > 0 ? sources[i % sources.size()] : start[j];
+                WalkDataType walk = walk_manager.encode(s, 0);
+                walk_manager.addWalk(s, walk, i );
+                if ( paths != NULL ) paths->record(0, i, 0, s);
+            }
         }
         degree = 0;
         count = 0;
     }
     
     /**
-     *  Walk update function.
+     *  Walk update function. Moves the walk through the current block, and
+     *  on through any other resident block, until it finishes or steps
+     *  into a block that is not in memory.
+     *  @param t the exec thread, whose private buffers receive the walk
      */
-    void updateByWalk(std::vector<Vertex> &vertices, int x, int curblock, std::map<vid_t, int> imap, walkManager &walk_manager){
-        Vertex vertex = vertices[x];
-        while (!walk_manager.emptyWalk(vertex.vid)){
-            vid_t dstId = vertex.vid;
-            int p = (int)*(bidx+dstId);
-            while (p == curblock ){
-                int y = imap[dstId];
-                Vertex &nowVertex = vertices[y];
-                WalkDataType nowWalk = walk_manager.getWalk(nowVertex.vid);
-                if (walk_manager.getHop(nowWalk) >= nsteps)
+    void updateByWalk(WalkRecord rec, int t, const blockCache &cache, int curblock, walkManager &walk_manager){
+#ifdef GRAPHWALKER_SECOND_ORDER
+        if (secondorder) {
+            updateSecondOrder(rec, t, cache, curblock, walk_manager);
+            return;
+        }
+#endif
+        WalkDataType walk = rec.walk;
+        vid_t dstId = rec.vertex;
+        int hop = walk_manager.getHop(walk), starthop = hop;
+        const csrBlock *block = cache.block(curblock);
+        int ldegree = 0, lcount = 0;
+        bool moved = false;
+        while (hop < nsteps){
+            int y = block->index[dstId];
+            walkRandom rng(seed, rec.id, hop);
+            bool in = direction != DIRECTION_OUT && inStep(hop, rng);
+            int deg = in ? block->ind(y) : block->outd(y);
+            ldegree += deg;
+            lcount++;
+            if ( alpha > 0 ) {
+                sketches[rec.id % sources.size()].visit(dstId);
+                /* The walk restarts, which is the start of a new walk from the source */
+                if ( rng.uniform() < alpha ) break;
+            }
+            if ( deg > 0 ) {
+                dstId = in ? random_inneighbor(*block, y, rng) : random_outneighbor(*block, y, rng);
+            }
+            else if ( alpha > 0 ) {
+                dstId = walk_manager.getSourceId(walk);
+            }
+            else{
+                dstId = rng.below(nvertices);
+            }
+            hop++;
+            if ( paths != NULL ) paths->record(t, rec.id, hop, dstId);
+            int p = walk_manager.getBlock(dstId);
+            if (hop < nsteps && p != curblock){
+                block = cache.block(p);
+                if (block == NULL) {
+                    walk_manager.moveWalk(walk, rec.id, dstId, hop, t);
+                    moved = true;
                     break;
-                degree += nowVertex.outd;
-                count++;
-                //nowVertex.set_data(nowVertex.get_data()+1);
-                if ( vertex.outd > 0 ) {
-                    vid_t v = random_outneighbor(vertex);
-                    dstId = v;
                 }
-                else{
-                    dstId = rand() % nvertices;
-                }
-                walk_manager.moveWalk(nowWalk, dstId);
-                p = (int)*(bidx+dstId);
+                walk_manager.stats.jumped(t);
+                curblock = p;
             }
-            walk_manager.walkscnt[p]++;
         }
+        if ( alpha > 0 && hop == nsteps )
+            sketches[rec.id % sources.size()].visit(dstId);
+        walk_manager.stats.walked(t, hop - starthop, !moved);
+        __sync_fetch_and_add(&degree, ldegree);
+        __sync_fetch_and_add(&count, lcount);
     }
     
+#ifdef GRAPHWALKER_SECOND_ORDER
+    /**
+     * Acceptance of proposal x at a step from v reached from u, decided by
+     * the coin r in [0, 1). Returns 1 or 0, or -1 if the answer depends on
+     * whether x is a neighbor of u.
+     */
+    int acceptProposal( vid_t x, vid_t u, double r ){
+        r *= maxbias;
+        if (x == u) return r < 1.0 / returnp;
+        if (r < std::min(1.0, 1.0 / inoutq)) return 1;
+        if (r >= std::max(1.0, 1.0 / inoutq)) return 0;
+        return -1;
+    }
+
+    /* The same once it is known whether the proposal is a neighbor of u. */
+    bool acceptNeighbor( bool neighbor, double r ){
+        return r * maxbias < (neighbor ? 1.0 : 1.0 / inoutq);
+    }
+
+    /**
+     * Second-order version of updateByWalk. Proposals are drawn at the
+     * current vertex; one that can only be decided by the neighbors of
+     * the previous vertex is tested at once if that block is resident and
+     * waits in it otherwise. Proposal k of a hop draws its coin first
+     * from stream PROPOSAL_STREAM + k, so a waiting proposal is decided
+     * with the same coin.
+     */
+    void updateSecondOrder(WalkRecord rec, int t, const blockCache &cache, int curblock, walkManager &walk_manager){
+        int hop = walk_manager.getHop(rec.walk), starthop = hop;
+        const csrBlock *block = cache.block(curblock);
+        int ldegree = 0, lcount = 0;
+        bool moved = false;
+        while (hop < nsteps){
+            vid_t next = NO_VERTEX;
+            if (rec.cand != NO_VERTEX) {
+                /* A proposal waiting in the block of prev */
+                walkRandom rng(seed, rec.id, hop, PROPOSAL_STREAM + rec.tries - 1);
+                if (acceptNeighbor(has_outneighbor(*block, block->index[rec.prev], rec.cand), rng.uniform()))
+                    next = rec.cand;
+                rec.cand = NO_VERTEX;
+            }else{
+                int y = block->index[rec.vertex];
+                int outd = block->outd(y);
+                if (rec.tries == 0) {
+                    ldegree += outd;
+                    lcount++;
+                }
+                if (rec.prev == NO_VERTEX || outd == 0) {
+                    /* First-order step, as in updateByWalk */
+                    walkRandom rng(seed, rec.id, hop);
+                    next = outd > 0 ? random_outneighbor(*block, y, rng) : rng.below(nvertices);
+                }else{
+                    walkRandom rng(seed, rec.id, hop, PROPOSAL_STREAM + rec.tries);
+                    rec.tries++;
+                    double r = rng.uniform();
+                    vid_t x = random_outneighbor(*block, y, rng);
+                    int accept = acceptProposal(x, rec.prev, r);
+                    if (accept < 0) {
+                        const csrBlock *prevblock = cache.block(walk_manager.getBlock(rec.prev));
+                        if (prevblock != NULL)
+                            accept = acceptNeighbor(has_outneighbor(*prevblock, prevblock->index[rec.prev], x), r);
+                        else
+                            rec.cand = x;
+                    }
+                    if (accept > 0) next = x;
+                }
+            }
+            if (next != NO_VERTEX) {
+                rec.prev = rec.vertex;
+                rec.vertex = next;
+                rec.tries = 0;
+                hop++;
+                if (paths != NULL) paths->record(t, rec.id, hop, next);
+            }
+            int p = walk_manager.getBlock(walk_home(rec));
+            if (hop < nsteps && p != curblock){
+                block = cache.block(p);
+                if (block == NULL) {
+                    rec.walk = walk_encoding::set_hop(rec.walk, hop);
+                    walk_manager.moveWalk(rec, t);
+                    moved = true;
+                    break;
+                }
+                walk_manager.stats.jumped(t);
+                curblock = p;
+            }
+        }
+        walk_manager.stats.walked(t, hop - starthop, !moved);
+        __sync_fetch_and_add(&degree, ldegree);
+        __sync_fetch_and_add(&count, lcount);
+    }
+#endif
+
     /**
      * Called before an execution interval is started.
      */
@@ -0,0 +1,129 @@
+#ifndef DEF_GRAPHWALKER_VISITSKETCH
+#define DEF_GRAPHWALKER_VISITSKETCH
+
+#include <stdint.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "api/datatype.hpp"
+#include "api/pthread_tools.hpp"
+
+#define VISITSKETCH_DEPTH 4
+
+/**
+ * Approximate visit counts of one walk source: a count-min sketch over
+ * all visited vertices and the k vertices with the largest estimates.
+ * Counting is lock-free; the lock of the source is only taken when a
+ * vertex enters or moves within the top k, which costs O(log k).
+ */
+class visitSketch
+{
+private:
+    unsigned width, k;
+    std::vector<uint32_t> counters;   // VISITSKETCH_DEPTH rows of width counters
+    /* Top k as a min-heap on the estimate, so the smallest is replaced first */
+    std::vector< std::pair<uint32_t, vid_t> > top;
+    /* Position in top of every vertex in the top k */
+    std::map<vid_t, unsigned> pos;
+    volatile uint32_t topmin;
+    volatile bool full;
+    spinlock toplock;
+
+    static uint32_t hash( vid_t v, int row ){
+        static const uint64_t mult[VISITSKETCH_DEPTH] = {
+            0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull };
+        return (uint32_t)(((uint64_t)(v + 1) * mult[row]) >> 32);
+    }
+
+    void place( unsigned i, std::pair<uint32_t, vid_t> e ){
+        top[i] = e;
+        pos[e.second] = i;
+    }
+
+    /* Moves entry i towards the root while it is smaller than its parent. */
+    void siftup( unsigned i ){
+        std::pair<uint32_t, vid_t> e = top[i];
+        while( i > 0 && e < top[(i - 1) / 2] ){
+            place(i, top[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, e);
+    }
+
+    /* Moves entry i towards the leaves while it is larger than a child. */
+    void siftdown( unsigned i ){
+        std::pair<uint32_t, vid_t> e = top[i];
+        unsigned n = top.size();
+        while( 2 * i + 1 < n ){
+            unsigned c = 2 * i + 1;
+            if( c + 1 < n && top[c + 1] < top[c] ) c++;
+            if( !(top[c] < e) ) break;
+            place(i, top[c]);
+            i = c;
+        }
+        place(i, e);
+    }
+
+public:
+    visitSketch() : width(0), k(0), topmin(0), full(false) {}
+
+    void init( unsigned _width, unsigned _k ){
+        width = _width;
+        k = _k;
+        counters.assign((size_t)width * VISITSKETCH_DEPTH, 0);
+        top.clear();
+        pos.clear();
+        topmin = 0;
+        full = false;
+    }
+
+    uint32_t estimate( vid_t v ) const {
+        uint32_t est = 0xffffffffu;
+        for( int r = 0; r < VISITSKETCH_DEPTH; r++ )
+            est = std::min(est, counters[(size_t)r * width + hash(v, r) % width]);
+        return est;
+    }
+
+    /* Thread-safe. */
+    void visit( vid_t v ){
+        uint32_t est = 0xffffffffu;
+        for( int r = 0; r < VISITSKETCH_DEPTH; r++ )
+            est = std::min(est, __sync_add_and_fetch(&counters[(size_t)r * width + hash(v, r) % width], 1u));
+        if( k == 0 || (full && est <= topmin) ) return;
+        toplock.lock();
+        std::map<vid_t, unsigned>::iterator it = pos.find(v);
+        if( it != pos.end() ){
+            /* Estimates only grow, so the entry can only move away from the root */
+            unsigned i = it->second;
+            if( est > top[i].first ){
+                top[i].first = est;
+                siftdown(i);
+            }
+        }else if( top.size() < k ){
+            top.push_back(std::make_pair(est, v));
+            siftup(top.size() - 1);
+        }else if( est > top.front().first ){
+            pos.erase(top.front().second);
+            top.front() = std::make_pair(est, v);
+            siftdown(0);
+        }
+        if( top.size() == k ){
+            topmin = top.front().first;
+            full = true;
+        }
+        toplock.unlock();
+    }
+
+    /* The top k vertices with their estimated visit counts, most visited first. */
+    std::vector< std::pair<vid_t, uint32_t> > topk() const {
+        std::vector< std::pair<uint32_t, vid_t> > sorted(top);
+        std::sort(sorted.begin(), sorted.end(), std::greater< std::pair<uint32_t, vid_t> >());
+        std::vector< std::pair<vid_t, uint32_t> > res;
+        for( unsigned i = 0; i < sorted.size(); i++ )
+            res.push_back(std::make_pair(sorted[i].second, sorted[i].first));
+        return res;
+    }
+};
+
+#endif
@@ -9,40 +9,204 @@
 #include <unistd.h>
 #include <assert.h>
 #include <string>
-#include <queue>
+#include <omp.h>
 
+#include "api/datatype.hpp"
+#include "api/blockmap.hpp"
+#include "api/filename.hpp"
+#include "api/io.hpp"
+#include "api/indexed_maxheap.hpp"
 #include "metrics/metrics.hpp"
+#include "walks/walktype.hpp"
+#include "walks/walkstats.hpp"
 
-typedef unsigned int WalkDataType;
+#define NO_VERTEX ((vid_t)-1)
+
+/**
+ * A walk together with the vertex it currently stays at. Walks are
+ * stored per block, so the current vertex has to travel with the walk.
+ * The id numbers the walks from 0 and keys their random streams.
+ *
+ * Second-order walks (make NODE2VEC=1) also carry the vertex they came
+ * from. A proposed step whose test needs the neighbors of that vertex
+ * waits in its block, so the proposal and the number of proposals drawn
+ * at the hop travel with the walk as well.
+ */
+struct WalkRecord {
+	WalkDataType walk;
+	vid_t vertex;
+	uint32_t id;
+#ifdef GRAPHWALKER_SECOND_ORDER
+	vid_t prev;         // NO_VERTEX at the start
+	vid_t cand;         // NO_VERTEX unless a proposal waits in the block of prev
+	uint32_t tries;
+#endif
+};
+
+static inline WalkRecord make_walk_record( WalkDataType walk, vid_t v, uint32_t id ){
+	WalkRecord rec;
+	rec.walk = walk;
+	rec.vertex = v;
+	rec.id = id;
+#ifdef GRAPHWALKER_SECOND_ORDER
+	rec.prev = rec.cand = NO_VERTEX;
+	rec.tries = 0;
+#endif
+	return rec;
+}
+
+/* Vertex whose block has to be resident to advance the walk. */
+static inline vid_t walk_home( const WalkRecord &rec ){
+#ifdef GRAPHWALKER_SECOND_ORDER
+	if( rec.cand != NO_VERTEX ) return rec.prev;
+#endif
+	return rec.vertex;
+}
+
+#define WALK_CHUNK_SIZE 4096
+
+/**
+ * Append-only walk buffer made of fixed-size chunks. Chunks are allocated
+ * only for live walks, and merging two buffers splices their chunk lists
+ * without copying any walk.
+ */
+class walkBuffer
+{
+public:
+	struct chunk {
+		chunk *next;
+		unsigned size;
+		WalkRecord walks[WALK_CHUNK_SIZE];
+	};
+private:
+	chunk *head, *tail;
+	size_t count;
+public:
+	walkBuffer() : head(NULL), tail(NULL), count(0) {}
+
+	static chunk *newChunk(){
+		chunk *c = (chunk*) malloc(sizeof(chunk));
+		c->next = NULL;
+		c->size = 0;
+		return c;
+	}
+
+	void push( WalkRecord rec ){
+		if( tail == NULL || tail->size == WALK_CHUNK_SIZE ){
+			chunk *c = newChunk();
+			if( tail == NULL ) head = c;
+			else tail->next = c;
+			tail = c;
+		}
+		tail->walks[tail->size++] = rec;
+		count++;
+	}
+
+	/* Moves all walks of other to the end of this buffer. */
+	void splice( walkBuffer &other ){
+		if( other.head == NULL ) return;
+		if( tail == NULL ) head = other.head;
+		else tail->next = other.head;
+		tail = other.tail;
+		count += other.count;
+		other.head = other.tail = NULL;
+		other.count = 0;
+	}
+
+	/* Hands the chunks over to the caller, who has to release them with freeChunks. */
+	void detach( std::vector<chunk*> &chunks ){
+		for( chunk *c = head; c != NULL; c = c->next )
+			chunks.push_back(c);
+		head = tail = NULL;
+		count = 0;
+	}
+
+	static void freeChunks( std::vector<chunk*> &chunks ){
+		for( unsigned i = 0; i < chunks.size(); i++ )
+			free(chunks[i]);
+		chunks.clear();
+	}
+
+	void clear(){
+		std::vector<chunk*> chunks;
+		detach(chunks);
+		freeChunks(chunks);
+	}
+
+	size_t size(){
+		return count;
+	}
+
+	bool empty(){
+		return count == 0;
+	}
+};
 
 class walkManager
 {
 public:
-	int nshards, num_vertex;
+	int nblocks, num_vertex, nthreads;
 	int nwalks,  lowerBound;
-	std::string walk_filename;
-	std::vector< std::queue<WalkDataType> > walks;
-	std::vector< int > walkscnt;
+	const blockMap *bidx;
+	/* Walks of each block */
+	std::vector< walkBuffer > walks;
+	/* Walks moved by each exec thread in the current round, per destination block */
+	std::vector< std::vector< walkBuffer > > localwalks;
+	/* Blocks whose local buffer of the thread received walks in the current round */
+	std::vector< std::vector< int > > touched;
+	std::vector< char > merging;
+	std::vector< int > mergelist;
+	/* Walk counts maintained incrementally, so scheduling does not scan the buffers.
+	 * They include the walks spilled to disk. */
+	std::vector< int > walknum;
+	long totalwalks;
+	/* Walks of each block in its walk file, and how many of them were read back */
+	std::vector< long > diskwalks, diskread;
+	/* Walks a block keeps in memory before they are appended to its walk file, 0 to never spill */
+	size_t spillwalks;
+	long spilled;
+	std::string base_filename;
+	indexed_maxheap<int> blockheap;
+	walkStats stats;
 	metrics &m;
 public:
 	walkManager( metrics &_m) : m(_m){}
 	~walkManager(){
-		walks.clear();
-		walkscnt.clear();
+		for( unsigned p = 0; p < walks.size(); p++ ){
+			walks[p].clear();
+			if( diskwalks[p] > 0 ) unlink(walksname(base_filename, p).c_str());
+		}
+		for( unsigned t = 0; t < localwalks.size(); t++ )
+			for( unsigned p = 0; p < localwalks[t].size(); p++ )
+				localwalks[t][p].clear();
 	}
 
-	void initialnizeWalks( int ns, int nv, std::string base_filename ){
-		nshards = ns;
-
+	/**
+	 * @param walkbudget bytes of walks kept in memory, split evenly among
+	 * the blocks; walks beyond that go to the walk files. 0 keeps all walks
+	 * in memory.
+	 */
+	void initialnizeWalks( int nb, int nv, int nt, const blockMap *idx, std::string _base_filename, size_t walkbudget ){
+		nblocks = nb;
 		num_vertex = nv;
-		walks.resize(num_vertex);
-		walkscnt.resize(num_vertex);
-
-		walk_filename = base_filename + ".walks";
-	     std::ofstream ofs;
-	     ofs.open(walk_filename.c_str(), std::ofstream::out );
-	     ofs << "random walks in  : " << base_filename << std::endl<< std::endl<< std::endl;
-	     ofs.close();
+		nthreads = nt;
+		bidx = idx;
+		walks.resize(nblocks);
+		localwalks.resize(nthreads);
+		for( int t = 0; t < nthreads; t++ )
+			localwalks[t].resize(nblocks);
+		touched.resize(nthreads);
+		merging.assign(nblocks, 0);
+		walknum.assign(nblocks, 0);
+		totalwalks = 0;
+		blockheap.resize(nblocks);
+		base_filename = _base_filename;
+		diskwalks.assign(nblocks, 0);
+		diskread.assign(nblocks, 0);
+		spillwalks = walkbudget / sizeof(WalkRecord) / nblocks;
+		if( walkbudget > 0 && spillwalks < WALK_CHUNK_SIZE ) spillwalks = WALK_CHUNK_SIZE;
+		spilled = 0;
+		stats.init(nblocks, nthreads);
 	}
 
 	void getWalkNum(int nw, int stopnw){
@@ -50,92 +214,180 @@ public:
 		lowerBound = stopnw;
 	}
 
-	WalkDataType encode( vid_t sourceId, int hop ){
-		assert( hop < 512 );
-		return (( sourceId & 0x7fffff ) << 9 ) | ( hop & 0x1ff ) ;
+	WalkDataType encode( vid_t sourceId, int hop, int aux = 0 ){
+		return walk_encoding::encode(sourceId, hop, aux);
 	}
 
 	vid_t getSourceId( WalkDataType walk ){
-		return ( walk >> 9 ) & 0x7fffff;
+		return walk_encoding::source(walk);
 	}
 
 	int getHop( WalkDataType walk ){
-		return (walk & 0x1ff) ;
+		return walk_encoding::hop(walk);
 	}
 
-	WalkDataType reencode( WalkDataType walk, vid_t toVertex ){
-		int hop = getHop(walk) + 1;
-		assert( hop < 512 );
-		return (walk + 1);
+	int getAux( WalkDataType walk ){
+		return walk_encoding::aux(walk);
 	}
 
-	WalkDataType getWalk( int v ){
-		WalkDataType walk = walks[v].front();
-		walks[v].pop();
-		return walk;
+	int getBlock( vid_t v ){
+		return bidx->block(v);
 	}
 
-	void addWalk( int v, WalkDataType walk ){
-		walks[v].push( walk );
+	/* Only called from a single thread, e.g. when the walks are started. */
+	void addWalk( vid_t v, WalkDataType walk, uint32_t id ){
+		WalkRecord rec = make_walk_record(walk, v, id);
+		int p = getBlock(v);
+		walks[p].push( rec );
+		walknum[p]++;
+		totalwalks++;
+		blockheap.update(p, walknum[p]);
+		if( spillwalks > 0 && walks[p].size() >= spillwalks )
+			spillWalks(p);
 	}
 
-	int getWalkSize(int v){
-		return walks[v].size();
+	/**
+	 * Appends the in-memory walks of block p to its walk file. Different
+	 * blocks may be spilled concurrently.
+	 */
+	void spillWalks( int p ){
+		std::vector<walkBuffer::chunk*> chunks;
+		long n = walks[p].size();
+		walks[p].detach(chunks);
+		std::string fname = walksname(base_filename, p);
+		int flags = O_WRONLY | O_CREAT | O_APPEND | (diskwalks[p] == 0 ? O_TRUNC : 0);
+		int f = open(fname.c_str(), flags, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+		if (f < 0) {
+			logstream(LOG_FATAL) << "Could not open " << fname << " error: " << strerror(errno) << std::endl;
+		}
+		assert(f >= 0);
+		for( unsigned i = 0; i < chunks.size(); i++ )
+			writea(f, (char*)chunks[i]->walks, chunks[i]->size * sizeof(WalkRecord));
+		close(f);
+		walkBuffer::freeChunks(chunks);
+		diskwalks[p] += n;
+		__sync_fetch_and_add(&spilled, n);
 	}
 
-	int getWalksDis( int p ){
-          	return walkscnt[p];
+	/* Streams up to max walks of block p back in from its walk file. */
+	long readWalks( int p, std::vector<walkBuffer::chunk*> &chunks, long max ){
+		long n = std::min(max, diskwalks[p] - diskread[p]);
+		if( n <= 0 ) return 0;
+		std::string fname = walksname(base_filename, p);
+		int f = open(fname.c_str(), O_RDONLY);
+		if (f < 0) {
+			logstream(LOG_FATAL) << "Could not load :" << fname << " error: " << strerror(errno) << std::endl;
+		}
+		assert(f >= 0);
+		for( long done = 0; done < n; ){
+			walkBuffer::chunk *c = walkBuffer::newChunk();
+			c->size = (unsigned)std::min((long)WALK_CHUNK_SIZE, n - done);
+			preada(f, (char*)c->walks, c->size * sizeof(WalkRecord), (diskread[p] + done) * sizeof(WalkRecord));
+			chunks.push_back(c);
+			done += c->size;
+		}
+		close(f);
+		diskread[p] += n;
+		if( diskread[p] == diskwalks[p] ){
+			unlink(fname.c_str());
+			diskwalks[p] = diskread[p] = 0;
+		}
+		return n;
+	}
+
+	/**
+	 * Moves a walk that leaves the current block to toVertex. Each exec thread
+	 * only touches its own buffers, which are merged in mergeLocalWalks.
+	 */
+	void moveWalk( WalkDataType walk, uint32_t id, vid_t toVertex, int hop, int t ){
+		moveWalk(make_walk_record(walk_encoding::set_hop(walk, hop), toVertex, id), t);
 	}
 
-	void moveWalk( WalkDataType walk, vid_t toVertex ){
-		walk = reencode( walk, toVertex );
-		walks[toVertex].push( walk );
+	/* Moves a walk record as it is, to the block of its home vertex. */
+	void moveWalk( const WalkRecord &rec, int t ){
+		int p = getBlock(walk_home(rec));
+		if( localwalks[t][p].empty() )
+			touched[t].push_back(p);
+		localwalks[t][p].push( rec );
+		__sync_fetch_and_add(&walknum[p], 1);
 	}
 
-	bool emptyWalk( vid_t v ){
-		return walks[v].empty();
+	/**
+	 * Takes out walks of block p for execution, the in-memory ones first.
+	 * When walks are spilled, at most one block's share of the walk budget
+	 * is taken at a time and the rest stays for the next call.
+	 * @return number of walks taken
+	 */
+	long getWalks( int p, std::vector<walkBuffer::chunk*> &chunks ){
+		long n = walks[p].size();
+		walks[p].detach(chunks);
+		long max = spillwalks > 0 ? (long)spillwalks : walknum[p];
+		if( n < max && diskwalks[p] > 0 ){
+			metrics_entry me = m.start_time();
+			n += readWalks(p, chunks, max - n);
+			m.stop_time(me, "_read-walks");
+		}
+		totalwalks -= n;
+		__sync_fetch_and_sub(&walknum[p], (int)n);
+		blockheap.update(p, walknum[p]);
+		return n;
+	}
+
+	/* Lock-free: every block is merged by exactly one thread. */
+	void mergeLocalWalks(){
+		metrics_entry me = m.start_time();
+		for( int t = 0; t < nthreads; t++ ){
+			for( unsigned i = 0; i < touched[t].size(); i++ ){
+				int p = touched[t][i];
+				if( !merging[p] ){
+					merging[p] = 1;
+					mergelist.push_back(p);
+				}
+			}
+			touched[t].clear();
+		}
+		int nmerge = (int)mergelist.size();
+		long merged = 0;
+		#pragma omp parallel for schedule(dynamic, 1) reduction(+:merged)
+		for( int i = 0; i < nmerge; i++ ){
+			int p = mergelist[i];
+			size_t before = walks[p].size();
+			for( int t = 0; t < nthreads; t++ )
+				walks[p].splice(localwalks[t][p]);
+			merged += walks[p].size() - before;
+			if( spillwalks > 0 && walks[p].size() >= spillwalks )
+				spillWalks(p);
+		}
+		for( int i = 0; i < nmerge; i++ ){
+			int p = mergelist[i];
+			merging[p] = 0;
+			blockheap.update(p, walknum[p]);
+		}
+		mergelist.clear();
+		totalwalks += merged;
+		m.stop_time(me, "_merge-local-walks");
+	}
+
+	/* Walks of block p, in memory and on disk */
+	int getWalksDis( int p ){
+		return walknum[p];
+	}
+
+	long getWalksOnDisk( int p ){
+		return diskwalks[p] - diskread[p];
 	}
 
      bool notFinish(){
-     		metrics_entry me = m.start_time();
-     		int sum = 0;
-          	for(int i=0; i < num_vertex; i++){
-          		sum += walks[i].size();
-          		if( sum > lowerBound ){
-          			m.stop_time(me, "_check-finish");
-          			return true;
-          		}
-          	}
-          	m.stop_time(me, "_check-finish");
-          	return false;
+     		return totalwalks > lowerBound;
      }
 
      int intervalWithMaxWalks(){
      		metrics_entry me = m.start_time();
-     		int maxw = 0, maxp = 0;
-          	for(int p = 0; p < nshards; p++) {
-	      	if( maxw < walkscnt[p] ){
-          			maxw = walkscnt[p];
-          			maxp = p;
-          		}
-	   	}
+     		int maxp = blockheap.top();
           	m.stop_time(me, "_find-block-with-max-walks");
           	return maxp;
      }
 
-     void printWalksDistribution( int exec_block ){
-     		metrics_entry me = m.start_time();
-     		std::ofstream ofs;
-	     ofs.open(walk_filename.c_str(), std::ofstream::out | std::ofstream::app );
-	   	int sum = 0;
-	  	for(int p = 0; p < nshards; p++) {
-	      	sum += walkscnt[p];
-	   	}
-	  	ofs << exec_block << " \t " << walkscnt[exec_block] << " \t " << sum << std::endl;
-	 	ofs.close();
-	 	m.stop_time(me, "_print-walks-distribution");
-     }
-     
 };
 
-#endif
\ No newline at end of file
+#endif
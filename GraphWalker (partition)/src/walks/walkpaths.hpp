@@ -0,0 +1,210 @@
+#ifndef DEF_GRAPHWALKER_WALKPATHS
+#define DEF_GRAPHWALKER_WALKPATHS
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "logger/logger.hpp"
+#include "api/datatype.hpp"
+#include "api/filename.hpp"
+#include "api/io.hpp"
+#include "api/pthread_tools.hpp"
+
+#define PATH_NO_VERTEX ((vid_t)-1)
+
+/* One hop of a walk: the walk reached vertex at hop */
+struct pathStep {
+    uint32_t id;
+    uint32_t hop;
+    vid_t vertex;
+};
+
+/* Header of a compressed segment of steps in a bucket file */
+struct pathSegment {
+    uint32_t nsteps;
+    uint32_t zbytes;
+};
+
+/**
+ * Records the vertices every walk visits and writes them out as one path
+ * per walk, ordered by walk id. The steps go into per-thread buffers; a
+ * full buffer is split by walk id range into buckets and appended to the
+ * bucket files as zlib-compressed segments. At the end the buckets are
+ * read back one at a time and their paths reassembled, so memory stays
+ * bounded by the buffers and one bucket of paths.
+ */
+class walkPathWriter
+{
+private:
+    struct threadBuffer {
+        std::vector<pathStep> steps;
+        char pad[64 - sizeof(std::vector<pathStep>) % 64];
+    };
+
+    std::string base_filename;
+    bool text;
+    unsigned pathlen;
+    uint32_t nwalks, bucketwalks;
+    int nbuckets;
+    size_t bufsteps;
+    std::vector<threadBuffer> buffers;
+    mutex *bucketlocks;
+    std::vector<char> bucketused;
+
+public:
+    /* Paths are written in word2vec text format, one line per walk. */
+    static const int FORMAT_TEXT = 1;
+    /* Paths are written as a length followed by the vertex ids. */
+    static const int FORMAT_BINARY = 0;
+
+    /**
+     * @param nsteps hops of a walk, which then visits nsteps + 1 vertices
+     * @param nthreads threads that record steps, numbered from 0
+     * @param membudget bytes of paths reassembled at a time
+     */
+    walkPathWriter( std::string _base_filename, int format, uint32_t _nwalks, unsigned nsteps, int nthreads, size_t membudget )
+        : base_filename(_base_filename), text(format == FORMAT_TEXT), pathlen(nsteps + 1), nwalks(_nwalks) {
+        bucketwalks = (uint32_t)std::max((size_t)1, membudget / (pathlen * sizeof(vid_t)));
+        nbuckets = nwalks == 0 ? 0 : (int)((nwalks - 1) / bucketwalks + 1);
+        bufsteps = 1 << 16;
+        buffers.resize(nthreads);
+        for( int t = 0; t < nthreads; t++ )
+            buffers[t].steps.reserve(bufsteps);
+        bucketlocks = new mutex[nbuckets];
+        bucketused.assign(nbuckets, 0);
+        mkdir((base_filename + "_block/").c_str(), 0777);
+        logstream(LOG_INFO) << "Recording walk paths in " << nbuckets << " buckets of " << bucketwalks << " walks." << std::endl;
+    }
+
+    ~walkPathWriter(){
+        for( int b = 0; b < nbuckets; b++ )
+            if( bucketused[b] ) unlink(pathsname(base_filename, b).c_str());
+        delete [] bucketlocks;
+    }
+
+    /* Thread t saw walk id arrive at vertex at hop. */
+    void record( int t, uint32_t id, unsigned hop, vid_t vertex ){
+        std::vector<pathStep> &steps = buffers[t].steps;
+        pathStep s = { id, hop, vertex };
+        steps.push_back(s);
+        if( steps.size() >= bufsteps ) flush(t);
+    }
+
+    /* Appends the buffer of thread t to the bucket files. */
+    void flush( int t ){
+        std::vector<pathStep> &steps = buffers[t].steps;
+        if( steps.empty() ) return;
+        /* Counting sort by bucket */
+        std::vector<size_t> start(nbuckets + 1, 0);
+        for( size_t i = 0; i < steps.size(); i++ )
+            start[steps[i].id / bucketwalks + 1]++;
+        for( int b = 0; b < nbuckets; b++ )
+            start[b + 1] += start[b];
+        std::vector<pathStep> sorted(steps.size());
+        std::vector<size_t> pos(start.begin(), start.end() - 1);
+        for( size_t i = 0; i < steps.size(); i++ )
+            sorted[pos[steps[i].id / bucketwalks]++] = steps[i];
+        steps.clear();
+
+        std::vector<Bytef> zbuf;
+        for( int b = 0; b < nbuckets; b++ ){
+            size_t n = start[b + 1] - start[b];
+            if( n == 0 ) continue;
+            uLongf zbytes = compressBound(n * sizeof(pathStep));
+            zbuf.resize(sizeof(pathSegment) + zbytes);
+            int ret = compress2(&zbuf[sizeof(pathSegment)], &zbytes, (const Bytef*)&sorted[start[b]], n * sizeof(pathStep), 1);
+            assert( ret == Z_OK );
+            pathSegment seg = { (uint32_t)n, (uint32_t)zbytes };
+            memcpy(&zbuf[0], &seg, sizeof(seg));
+            appendSegment(b, &zbuf[0], sizeof(pathSegment) + zbytes);
+        }
+    }
+
+    void appendSegment( int b, const Bytef *data, size_t nbytes ){
+        std::string fname = pathsname(base_filename, b);
+        bucketlocks[b].lock();
+        int flags = O_WRONLY | O_CREAT | O_APPEND | (bucketused[b] ? 0 : O_TRUNC);
+        int f = open(fname.c_str(), flags, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+        if (f < 0) {
+            logstream(LOG_FATAL) << "Could not open " << fname << " error: " << strerror(errno) << std::endl;
+        }
+        assert(f >= 0);
+        writea(f, (const char*)data, nbytes);
+        close(f);
+        bucketused[b] = 1;
+        bucketlocks[b].unlock();
+    }
+
+    /**
+     * Flushes all threads and writes the paths to outname in walk id
+     * order. A walk that ended early, like a restarted PPR walk, has a
+     * shorter path.
+     */
+    void write( std::string outname ){
+        for( unsigned t = 0; t < buffers.size(); t++ )
+            flush(t);
+        FILE *out = fopen(outname.c_str(), text ? "w" : "wb");
+        if (out == NULL) {
+            logstream(LOG_FATAL) << "Could not open " << outname << " error: " << strerror(errno) << std::endl;
+        }
+        assert(out != NULL);
+        std::vector<vid_t> paths;
+        std::vector<pathStep> steps;
+        std::vector<char> zbuf;
+        for( int b = 0; b < nbuckets; b++ ){
+            uint32_t first = b * bucketwalks;
+            uint32_t n = std::min(bucketwalks, nwalks - first);
+            paths.assign((size_t)n * pathlen, PATH_NO_VERTEX);
+            if( bucketused[b] ){
+                std::string fname = pathsname(base_filename, b);
+                int f = open(fname.c_str(), O_RDONLY);
+                assert(f >= 0);
+                size_t sz = lseek(f, 0, SEEK_END);
+                for( size_t off = 0; off < sz; ){
+                    pathSegment seg;
+                    preada(f, &seg, sizeof(seg), off);
+                    off += sizeof(seg);
+                    zbuf.resize(seg.zbytes);
+                    preada(f, &zbuf[0], seg.zbytes, off);
+                    off += seg.zbytes;
+                    steps.resize(seg.nsteps);
+                    uLongf nbytes = seg.nsteps * sizeof(pathStep);
+                    int ret = uncompress((Bytef*)&steps[0], &nbytes, (const Bytef*)&zbuf[0], seg.zbytes);
+                    assert( ret == Z_OK && nbytes == seg.nsteps * sizeof(pathStep) );
+                    for( uint32_t i = 0; i < seg.nsteps; i++ )
+                        paths[(size_t)(steps[i].id - first) * pathlen + steps[i].hop] = steps[i].vertex;
+                }
+                close(f);
+                unlink(fname.c_str());
+                bucketused[b] = 0;
+            }
+            for( uint32_t w = 0; w < n; w++ )
+                writePath(out, &paths[(size_t)w * pathlen]);
+        }
+        fclose(out);
+        logstream(LOG_INFO) << "Wrote the paths of " << nwalks << " walks to " << outname << std::endl;
+    }
+
+private:
+    void writePath( FILE *out, const vid_t *path ){
+        uint32_t len = 0;
+        while( len < pathlen && path[len] != PATH_NO_VERTEX ) len++;
+        if( text ){
+            for( uint32_t i = 0; i < len; i++ )
+                fprintf(out, i == 0 ? "%u" : " %u", (unsigned)path[i]);
+            fputc('\n', out);
+        }else{
+            fwrite(&len, sizeof(len), 1, out);
+            fwrite(path, sizeof(vid_t), len, out);
+        }
+    }
+};
+
+#endif
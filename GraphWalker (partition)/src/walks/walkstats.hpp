@@ -0,0 +1,164 @@
+#ifndef DEF_GRAPHWALKER_WALKSTATS
+#define DEF_GRAPHWALKER_WALKSTATS
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+#include "metrics/metrics.hpp"
+
+/* Histogram snapshots kept; beyond that every other one is dropped */
+#define WALKSTATS_MAX_SNAPSHOTS 64
+/* Buckets of the walks per block histogram: empty blocks, then powers of two */
+#define WALKSTATS_HIST_BUCKETS 32
+
+/**
+ * Walk-centric counters of a run: how often every block was loaded, how
+ * many walk steps were executed per load, and whether walks finished in
+ * the blocks they were executed in or had to cross to a block that was
+ * not resident. The exec threads only bump their own padded counters,
+ * which are summed up by the engine thread between exec rounds, and the
+ * distribution of walks over the blocks is sampled in memory, so the
+ * counters can stay on in every run. Everything is handed to the metrics
+ * at the end by report.
+ */
+class walkStats
+{
+private:
+    struct threadCounters {
+        long steps, finished, crossed, jumped;
+        char pad[64 - 4 * sizeof(long)];
+    };
+
+    std::vector<threadCounters> threads;
+    /* Loads and executed steps of every block as the exec block */
+    std::vector<long> loads, blocksteps;
+    double bytes;
+    long laststeps;
+    /* Histogram of walks per block every sampleevery intervals */
+    std::vector< std::vector<long> > hist;
+    std::vector<long> histinterval;
+    long intervals, sampleevery;
+
+    long sum( long threadCounters::*field ) const {
+        long s = 0;
+        for( unsigned t = 0; t < threads.size(); t++ )
+            s += threads[t].*field;
+        return s;
+    }
+
+    static int bucket( long walks ){
+        int b = 0;
+        while( walks > 0 && b < WALKSTATS_HIST_BUCKETS - 1 ){
+            walks >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+public:
+    walkStats() : bytes(0), laststeps(0), intervals(0), sampleevery(1) {}
+
+    void init( int nblocks, int nthreads ){
+        threadCounters zero = threadCounters();
+        threads.assign(nthreads, zero);
+        loads.assign(nblocks, 0);
+        blocksteps.assign(nblocks, 0);
+        bytes = 0;
+        laststeps = 0;
+        hist.clear();
+        histinterval.clear();
+        intervals = 0;
+        sampleevery = 1;
+    }
+
+    /**
+     * Thread t advanced a walk by steps hops. The walk either finished,
+     * counting a restart of a PPR walk, or crossed to a block that was
+     * not resident.
+     */
+    inline void walked( int t, long steps, bool finished ){
+        threadCounters &c = threads[t];
+        c.steps += steps;
+        if( finished ) c.finished++;
+        else c.crossed++;
+    }
+
+    /* Thread t continued a walk in another resident block. */
+    inline void jumped( int t ){
+        threads[t].jumped++;
+    }
+
+    /* Engine thread only, like the rest below. */
+    void loaded( int p, size_t nbytes ){
+        loads[p]++;
+        bytes += nbytes;
+    }
+
+    /* The steps executed since the last call are charged to exec block p. */
+    void execDone( int p ){
+        long steps = sum(&threadCounters::steps);
+        blocksteps[p] += steps - laststeps;
+        laststeps = steps;
+    }
+
+    /**
+     * Called before every interval with the walks of every block. The
+     * sampling period doubles whenever the snapshots fill up, so long runs
+     * keep a bounded, evenly spaced history.
+     */
+    void sample( const std::vector<int> &walknum ){
+        long interval = intervals++;
+        if( interval % sampleevery != 0 ) return;
+        if( hist.size() == WALKSTATS_MAX_SNAPSHOTS ){
+            for( unsigned i = 0; i < hist.size() / 2; i++ ){
+                hist[i].swap(hist[2 * i]);
+                histinterval[i] = histinterval[2 * i];
+            }
+            hist.resize(hist.size() / 2);
+            histinterval.resize(histinterval.size() / 2);
+            sampleevery *= 2;
+            if( interval % sampleevery != 0 ) return;
+        }
+        std::vector<long> h(WALKSTATS_HIST_BUCKETS, 0);
+        for( unsigned p = 0; p < walknum.size(); p++ )
+            h[bucket(walknum[p])]++;
+        while( h.size() > 1 && h.back() == 0 ) h.pop_back();
+        hist.push_back(h);
+        histinterval.push_back(interval);
+    }
+
+    /**
+     * Totals as walk_steps, walks_finished_in_block, walks_crossed_blocks,
+     * walks_jumped_blocks, steps_per_load and bytes_per_step, the per-block
+     * vectors per_block.loads, per_block.steps and per_block.steps_per_load,
+     * and one vector walks_per_block_hist.<interval> per snapshot, where
+     * entry 0 counts the blocks without walks and entry k > 0 the blocks
+     * with 2^(k-1) to 2^k - 1 walks.
+     */
+    void report( metrics &m ){
+        long steps = sum(&threadCounters::steps);
+        long nloads = 0;
+        for( unsigned p = 0; p < loads.size(); p++ )
+            nloads += loads[p];
+        m.set("walk_steps", (size_t)steps);
+        m.set("walks_finished_in_block", (size_t)sum(&threadCounters::finished));
+        m.set("walks_crossed_blocks", (size_t)sum(&threadCounters::crossed));
+        m.set("walks_jumped_blocks", (size_t)sum(&threadCounters::jumped));
+        if( nloads > 0 ) m.set("steps_per_load", (double)steps / nloads);
+        if( steps > 0 ) m.set("bytes_per_step", bytes / steps);
+        for( unsigned p = 0; p < loads.size(); p++ ){
+            m.add_vector_entry("per_block.loads", p, (double)loads[p]);
+            m.add_vector_entry("per_block.steps", p, (double)blocksteps[p]);
+            m.add_vector_entry("per_block.steps_per_load", p, loads[p] > 0 ? (double)blocksteps[p] / loads[p] : 0.0);
+        }
+        for( unsigned i = 0; i < hist.size(); i++ ){
+            char key[64];
+            sprintf(key, "walks_per_block_hist.%08ld", histinterval[i]);
+            for( unsigned b = 0; b < hist[i].size(); b++ )
+                m.add_vector_entry(key, b, (double)hist[i][b]);
+        }
+    }
+};
+
+#endif
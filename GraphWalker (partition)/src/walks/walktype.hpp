@@ -0,0 +1,97 @@
+#ifndef DEF_GRAPHWALKER_WALKTYPE
+#define DEF_GRAPHWALKER_WALKTYPE
+
+#include <stdint.h>
+#include <assert.h>
+
+#include "api/datatype.hpp"
+
+/**
+ * Bit layout of an encoded walk, from the most significant bits:
+ * source vertex id | auxiliary payload | hop count.
+ * The auxiliary field can carry per-walk state such as a restart flag.
+ */
+template <typename T>
+struct walk_layout;
+
+template <>
+struct walk_layout<uint32_t> {
+    enum { SOURCE_BITS = 23, AUX_BITS = 0, HOP_BITS = 9 };
+};
+
+template <>
+struct walk_layout<uint64_t> {
+    enum { SOURCE_BITS = 32, AUX_BITS = 16, HOP_BITS = 16 };
+};
+
+template <typename T, typename layout = walk_layout<T> >
+struct walk_codec {
+    typedef T walk_t;
+
+    enum {
+        SOURCE_BITS = layout::SOURCE_BITS,
+        AUX_BITS = layout::AUX_BITS,
+        HOP_BITS = layout::HOP_BITS,
+        HOP_SHIFT = 0,
+        AUX_SHIFT = HOP_BITS,
+        SOURCE_SHIFT = HOP_BITS + AUX_BITS
+    };
+
+    static T mask( int bits ){
+        return bits == 0 ? (T)0 : (T)(~(T)0) >> (8 * sizeof(T) - bits);
+    }
+
+    /* Largest graph (in vertices) and longest walk the layout can describe. */
+    static uint64_t max_vertices(){
+        return (uint64_t)mask(SOURCE_BITS) + 1;
+    }
+
+    static unsigned max_hop(){
+        return (unsigned)mask(HOP_BITS);
+    }
+
+    static T encode( vid_t source, unsigned hop, unsigned aux = 0 ){
+        assert( hop <= max_hop() );
+        assert( (T)aux <= mask(AUX_BITS) );
+        return (((T)source & mask(SOURCE_BITS)) << SOURCE_SHIFT)
+             | (((T)aux & mask(AUX_BITS)) << AUX_SHIFT)
+             | (((T)hop & mask(HOP_BITS)) << HOP_SHIFT);
+    }
+
+    static vid_t source( T walk ){
+        return (vid_t)((walk >> SOURCE_SHIFT) & mask(SOURCE_BITS));
+    }
+
+    static unsigned hop( T walk ){
+        return (unsigned)((walk >> HOP_SHIFT) & mask(HOP_BITS));
+    }
+
+    static unsigned aux( T walk ){
+        return (unsigned)((walk >> AUX_SHIFT) & mask(AUX_BITS));
+    }
+
+    static T set_hop( T walk, unsigned hop ){
+        assert( hop <= max_hop() );
+        return (walk & ~(mask(HOP_BITS) << HOP_SHIFT)) | (((T)hop & mask(HOP_BITS)) << HOP_SHIFT);
+    }
+
+    static T set_aux( T walk, unsigned aux ){
+        assert( (T)aux <= mask(AUX_BITS) );
+        return (walk & ~(mask(AUX_BITS) << AUX_SHIFT)) | (((T)aux & mask(AUX_BITS)) << AUX_SHIFT);
+    }
+};
+
+/**
+ * The walk representation is chosen at compile time. Build with
+ * -DGRAPHWALKER_WALK64 (make WALK64=1) for graphs of more than 2^23
+ * vertices or walks longer than 511 hops.
+ */
+#ifdef GRAPHWALKER_WALK64
+typedef walk_codec<uint64_t> walk_encoding;
+#else
+typedef walk_codec<uint32_t> walk_encoding;
+#endif
+
+typedef walk_encoding::walk_t WalkDataType;
+
+#endif
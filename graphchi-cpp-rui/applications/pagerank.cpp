@@ -28,6 +28,7 @@ int main(int argc, const char ** argv) {
     int nwalks = get_option_int("nwalks", 9495200); // Number of walks
     int nsteps = get_option_int("nsteps", 4); // Number of steps
     float rbound = get_option_float("rbound", 0); // Ratio of lower bound  of stop walks
+    unsigned seed = get_option_int("seed", (int)time(NULL)); // Seed of the walks; out of core, runs repeat exactly with loadthreads 1
     float choseprob = get_option_float("choseprob", 0); // Ratio of lower bound  of interval stop walks
     
     /* Detect the number of shards or preprocess an input to create them */
@@ -36,7 +37,7 @@ int main(int argc, const char ** argv) {
 
     /* Run */
     RandomWalkProgram program;
-    program.initialization( nvertices, nwalks, nsteps, rbound );
+    program.initialization( nvertices, nwalks, nsteps, rbound, seed );
     graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
     if (preexisting_shards) {
         // engine.reinitialize_edge_data(0);
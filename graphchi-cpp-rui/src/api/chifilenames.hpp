@@ -152,6 +152,32 @@ namespace graphchi {
         return adjfilename + "idx";
     }
     
+    /**
+     * Encoding of the neighbor ids in an adjacency file, missing if raw
+     */
+    static std::string filename_shard_adj_encoding(std::string adjfilename) {
+        return adjfilename + ".encoding";
+    }
+    
+    /**
+     * Alias tables of the out-edges of the vertices of interval p, only
+     * written for weighted graphs
+     */
+    static std::string filename_shard_alias(std::string basefilename, int p, int nshards) {
+        std::stringstream ss;
+        ss << basefilename;
+        ss << ".alias.";
+        ss << p << "_" << nshards;
+        return ss.str();
+    }
+    
+    /**
+     * Codec of the edge data blocks of a graph, missing if zlib
+     */
+    static std::string filename_edata_codec(std::string basefilename) {
+        return basefilename + ".edatacodec";
+    }
+    
     /**
      * Configuration file name
      */
@@ -354,6 +380,20 @@ namespace graphchi {
                 if (err != 0) logstream(LOG_ERROR) << "Error removing file " << idxname
                     << ", " << strerror(errno) << std::endl;
             }
+            
+            std::string encname = filename_shard_adj_encoding(adjname);
+            if (file_exists(encname)) {
+                int err = remove(encname.c_str());
+                if (err != 0) logstream(LOG_ERROR) << "Error removing file " << encname
+                    << ", " << strerror(errno) << std::endl;
+            }
+            
+            std::string aliasname = filename_shard_alias(base_filename, p, nshards);
+            if (file_exists(aliasname)) {
+                int err = remove(aliasname.c_str());
+                if (err != 0) logstream(LOG_ERROR) << "Error removing file " << aliasname
+                    << ", " << strerror(errno) << std::endl;
+            }
 
         }
         
@@ -364,6 +404,13 @@ namespace graphchi {
                 << ", " << strerror(errno) << std::endl;
         }
         
+        std::string codec_filename = filename_edata_codec(base_filename);
+        if (file_exists(codec_filename)) {
+            int err = remove(codec_filename.c_str());
+            if (err != 0) logstream(LOG_ERROR) << "Error removing file " << codec_filename
+                << ", " << strerror(errno) << std::endl;
+        }
+        
         /* Degree file */
         std::string deg_filename = filename_degree_data(base_filename);
         if (file_exists(deg_filename)) {
@@ -288,9 +288,30 @@ namespace graphchi {
             return &this->outedges_ptr[i];
         }        
         
-        graphchi_edge<EdgeDataType> * random_outedge() {
+        /**
+         * Uniformly random out-edge, NULL for a sink.
+         * @param rng draws with below(n), e.g. the walkRandom of a walk step
+         */
+        template <typename RNG>
+        graphchi_edge<EdgeDataType> * random_outedge(RNG &rng) {
             if (this->outc == 0) return NULL;
-            return outedge((int) (std::abs(random()) % this->outc));
+            return outedge((int) rng.below(this->outc));
+        }
+        
+        /**
+         * Random out-edge drawn by weight in O(1) from the alias table of
+         * the vertex, uniformly if the graph has no alias tables; NULL for
+         * a sink. The engine sorts the out-edges by target when it loads
+         * the tables, which is the order they index.
+         * @param aliases alias tables of the loaded vertices, graphchi_context::aliases
+         */
+        template <typename RNG, typename ALIAS>
+        graphchi_edge<EdgeDataType> * random_outedge(RNG &rng, const ALIAS * aliases) {
+            if (aliases == NULL) return random_outedge(rng);
+            if (this->outc == 0) return NULL;
+            int j = (int) rng.below(this->outc);
+            const typename ALIAS::entry_t * row = aliases->row(this->vertexid);
+            return outedge(rng.uniform() < row[j].prob ? j : (int) row[j].alias);
         }
             
         /** 
@@ -342,6 +363,14 @@ namespace graphchi {
             
         }
         
+        /**
+         * Sorts the out-edges by target. Shards loaded in parallel append
+         * them in any order, the alias tables index them in this one.
+         */
+        void VARIABLE_IS_NOT_USED sort_outedges() {
+            if (this->outc > 1) quickSort(this->outedges_ptr, (int) this->outc, eptr_less<EdgeDataType>);
+        }
+        
         
 #ifdef SUPPORT_DELETIONS
         void VARIABLE_IS_NOT_USED remove_edge(int i) {
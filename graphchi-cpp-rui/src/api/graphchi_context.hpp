@@ -42,6 +42,8 @@
 
 namespace graphchi {
     
+    class alias_table;
+    
     struct graphchi_context {
 
         size_t nvertices;
@@ -56,8 +58,10 @@ namespace graphchi {
         timeval start;
         std::string filename;
         double last_deltasum;
+        /* Alias tables of the loaded vertices of a weighted graph, else NULL */
+        const alias_table * aliases;
         
-        graphchi_context() : scheduler(NULL), iteration(0), last_iteration(-1) {
+        graphchi_context() : scheduler(NULL), iteration(0), last_iteration(-1), aliases(NULL) {
             gettimeofday(&start, NULL);
             last_deltasum = 0.0;
         }
@@ -267,6 +267,10 @@ namespace graphchi {
                 std::string edata_filename = filename_shard_edata<EdgeDataType>(this->base_filename, shard, this->nshards);
                 std::string adj_filename = filename_shard_adj(this->base_filename, shard, this->nshards);
                 std::string dest_adj = filename_shard_adj(this->base_filename, 0, 0) + ".dyngraph" + shard_suffices[shard];          
+                if (read_adj_encoding(adj_filename).type != ADJ_RAW) {
+                    logstream(LOG_FATAL) << "Dynamic graphs rewrite raw shards, preprocess " << this->base_filename << " with shard.adjencoding raw." << std::endl;
+                    assert(false);
+                }
                 std::string dest_edata = filename_shard_edata<EdgeDataType>(this->base_filename, 0, 0) + ".dyngraph" + shard_suffices[shard];
                 
                 cpedata(edata_filename, dest_edata, true);
@@ -953,7 +957,7 @@ namespace graphchi {
             
             std::string block_filename = filename_shard_edata_block(shard_filename, blockid, base_engine::blocksize);
             int f = open(block_filename.c_str(), O_RDWR | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-            write_compressed(f, buf, len);
+            write_compressed(f, buf, len, base_engine::iomgr->get_block_codec());
             close(f);
         }
         
@@ -49,13 +49,16 @@
 #include "engine/auxdata/vertex_data.hpp"
 #include "engine/bitset_scheduler.hpp"
 #include "io/stripedio.hpp"
+#include "io/edatacodec.hpp"
 #include "logger/logger.hpp"
 #include "metrics/metrics.hpp"
 #include "shards/memoryshard.hpp"
 #include "shards/slidingshard.hpp"
+#include "shards/aliastable.hpp"
 #include "util/pthread_tools.hpp"
 #include "output/output.hpp"
 #include "walks/walk.hpp"   // -Rui
+#include "walks/walkscheduler.hpp"
 
 namespace graphchi {
     
@@ -121,6 +124,17 @@ namespace graphchi {
         bool reset_vertexdata;
         bool save_edgesfiles_after_inmemmode;
         
+        /* In-memory mode: the whole graph stays loaded for the run */
+        bool inmemory;
+        /* The in-memory mode was chosen because the graph fits, not asked for */
+        bool inmemory_auto;
+        std::vector<memshard_t *> inmemory_shards;
+        std::vector<svertex_t> inmemory_vertices;
+        graphchi_edge<EdgeDataType> * inmemory_edata;
+        
+        /* Alias tables of the loaded vertices, NULL unless the graph is weighted */
+        alias_table * aliases;
+        
         /* Outputs */
         std::vector<ioutput<VertexDataType, EdgeDataType> *> outputs;
         
@@ -129,6 +143,10 @@ namespace graphchi {
 
         /* --Rui */
         walkManager *walk_manager;
+        walkCostModel *walk_cost;
+        walkScheduler *walk_scheduler;
+        /* Walk steps advanced in the current interval */
+        long interval_steps;
         int numIntervals;
         
         void print_config() {
@@ -152,6 +170,7 @@ namespace graphchi {
             /* Initialize IO */
             m.start_time("iomgr_init");
             iomgr = new stripedio(m);
+            iomgr->set_block_codec(edata_codec_option(base_filename));
             m.stop_time("iomgr_init");
 #ifndef DYNAMICEDATA
             logstream(LOG_INFO) << "Initializing graphchi_engine. This engine expects " << sizeof(EdgeDataType)
@@ -175,6 +194,10 @@ namespace graphchi {
             modifies_outedges = true;
             modifies_inedges = true;
             save_edgesfiles_after_inmemmode = false;
+            inmemory = false;
+            inmemory_auto = false;
+            inmemory_edata = NULL;
+            aliases = NULL;
 
             only_adjacency = false;
             disable_outedges = false;
@@ -204,8 +227,15 @@ namespace graphchi {
             _load_vertex_intervals();
 
             /* -- Rui */
+            if ((uint64_t)num_vertices() > walk_encoding::max_vertices()) {
+                logstream(LOG_FATAL) << "Graph has " << num_vertices() << " vertices, but " << 8 * sizeof(WalkDataType)
+                    << "-bit walks can only address " << walk_encoding::max_vertices() << ". Rebuild with WALK64=1." << std::endl;
+            }
+            assert((uint64_t)num_vertices() <= walk_encoding::max_vertices());
             walk_manager = new walkManager(m);
             walk_manager->initialnizeWalks(nshards, (int)num_vertices(), base_filename ,intervals);
+            walk_cost = NULL;
+            walk_scheduler = NULL;
             
             _m.set("file", _base_filename);
             _m.set("engine", "default");
@@ -227,6 +257,9 @@ namespace graphchi {
             }
             degree_handler = NULL;
             vertex_data_handler = NULL;
+            if (walk_scheduler != NULL) delete walk_scheduler;
+            if (walk_cost != NULL) delete walk_cost;
+            if (aliases != NULL) delete aliases;
             delete iomgr;
         }
         
@@ -299,11 +332,30 @@ namespace graphchi {
         }
         
         /**
-         * If the data is only in one shard, we can just
-         * keep running from memory.
+         * With option inmemory the whole graph is loaded once and kept in
+         * memory for the run. Decided by run().
          */
         virtual bool is_inmemory_mode() {
-            return (nshards == 1 && num_vertices() < 2 * maxwindow); // Do not switch to in-memory mode if num of vertices too high. Ugly heuristic.
+            return inmemory;
+        }
+        
+        /**
+         * Estimates the memory needed to keep the whole graph loaded: the
+         * vertex objects, an in-edge and an out-edge object per edge, and
+         * the shard files themselves.
+         */
+        virtual size_t inmemory_bytes() {
+            size_t bytes = 0;
+            for(int p=0; p < nshards; p++) bytes += interval_bytes(p);
+            size_t edges = (nedges > 0 ? nedges : bytes / sizeof(vid_t));
+            bytes += num_vertices() * (sizeof(svertex_t) + sizeof(VertexDataType));
+            bytes += edges * 2 * sizeof(graphchi_edge<EdgeDataType>);
+            if (aliases != NULL) bytes += alias_table::bytes(num_vertices(), edges);
+            return bytes;
+        }
+
+        virtual bool fits_in_memory() {
+            return inmemory_bytes() <= size_t(membudget_mb) * 1024 * 1024;
         }
         
         
@@ -397,6 +449,25 @@ namespace graphchi {
             
             /* Wait for all reads to complete */
             iomgr->wait_for_reads();
+            load_alias_tables(vertices, sub_interval_st);
+        }
+        
+        /**
+         * Loads the alias tables of the vertices st onwards and puts their
+         * out-edges in the order of the tables, sorted by target.
+         */
+        void load_alias_tables(std::vector<svertex_t> &vertices, vid_t st) {
+            if (aliases == NULL || disable_outedges || vertices.empty()) return;
+            aliases->load(st, st + (vid_t)vertices.size() - 1);
+#pragma omp parallel for
+            for(int i=0; i < (int)vertices.size(); i++) {
+                if (aliases->degree(st + i) != vertices[i].num_outedges()) {
+                    logstream(LOG_FATAL) << "Vertex " << (st + i) << " has " << vertices[i].num_outedges() << " out-edges but an alias table of "
+                        << aliases->degree(st + i) << ". Shard the graph again." << std::endl;
+                    assert(false);
+                }
+                vertices[i].sort_outedges();
+            }
         }
         
         virtual void exec_updates(GraphChiProgram<VertexDataType, EdgeDataType, svertex_t> &userprogram,
@@ -471,6 +542,7 @@ namespace graphchi {
                         }
                 }
             } while (userprogram.repeat_updates(chicontext));
+            walk_manager->mergeOutboxes();
             
             m.stop_time(me, "execute-updates");
         }
@@ -693,21 +765,34 @@ namespace graphchi {
             }while( walk_manager->getWalksDis(exec_interval) > tt );
         }
 
+        /**
+         * Passes over the interval until its walks are done, or until the
+         * walk scheduler decides to leave the rest for a later visit.
+         * A pass advances every walk of the interval by at least one step.
+         */
         void walkToEnd(GraphChiProgram<VertexDataType, EdgeDataType, svertex_t> &userprogram, std::vector<svertex_t> &vertices){
             while(  walk_manager->notFinishInterval(exec_interval) ){
-                if (!is_inmemory_mode()) {
-                    exec_updates(userprogram, vertices);
-                    /* Load phase after updates (used by the functional engine) */
-                    load_after_updates(vertices);
-                } else {
-                    //exec_updates_inmemory_mode(userprogram, vertices); 
-                }
+                long steps = walk_manager->getWalksDis(exec_interval);
+                timeval st, en;
+                gettimeofday(&st, NULL);
+                walk_manager->beginPass(exec_interval);
+                exec_updates(userprogram, vertices);
+                /* Load phase after updates (used by the functional engine) */
+                load_after_updates(vertices);
+                gettimeofday(&en, NULL);
+                interval_steps += steps;
                 // logstream(LOG_INFO) << "walks in exec_interval : " << walk_manager.getWalksDis(exec_interval) << std::endl;
+                if (!walk_scheduler->continue_interval(*walk_manager, exec_interval, steps, en.tv_sec - st.tv_sec + ((double)(en.tv_usec - st.tv_usec)) / 1.0E6)) {
+                    m.add("walk_earlystops", 1);
+                    break;
+                }
             }
         }
 
         void runInterval(GraphChiProgram<VertexDataType, EdgeDataType, svertex_t> &userprogram){
                     metrics_entry mb = m.start_time();
+                    timeval st, ld, en;
+                    gettimeofday(&st, NULL);
                 /* Determine interval limits */
                     vid_t interval_st = get_interval_start(exec_interval);
                     vid_t interval_en = get_interval_end(exec_interval);
@@ -771,14 +856,24 @@ namespace graphchi {
                         
                         // logstream(LOG_INFO) << "Start updates" << std::endl;
                         // walkOnce(userprogram, vertices);
+                        gettimeofday(&ld, NULL);
+                        interval_steps = 0;
+                        walk_manager->visits.begin(sub_interval_st, sub_interval_en);
                         walkToEnd(userprogram, vertices);
+                        gettimeofday(&en, NULL);
+                        walk_scheduler->interval_done(exec_interval,
+                            ld.tv_sec - st.tv_sec + ((double)(ld.tv_usec - st.tv_usec)) / 1.0E6, interval_steps,
+                            en.tv_sec - ld.tv_sec + ((double)(en.tv_usec - ld.tv_usec)) / 1.0E6);
                         // walksometimes(userprogram, vertices, t);
                         // logstream(LOG_INFO) << "Finished updates" << std::endl;
                         
                         /* Save vertices */
                         metrics_entry ma = m.start_time();
                         if (!disable_vertexdata_storage) {
+                            walk_manager->visits.flush(vertices);
                             save_vertices(vertices);
+                        } else {
+                            walk_manager->visits.reset();
                         }
                         sub_interval_st = sub_interval_en + 1;
                         
@@ -807,22 +902,19 @@ namespace graphchi {
                     m.stop_time(ma, "_after_exec_interval");
         }
 
-        int NextInvlwithRandom( float c ){
-            int cc = rand() % 100;
-            if( cc < (int)(c*100) ){
-                int p = walk_manager->intervalWithRandom();
-                if( p != exec_interval ) return p;
-            }
-            return walk_manager->intervalWithMaxWalks();
-        }
-
-        int NextInvlwithMinStep( float c ){
-            int cc = rand() % 100;
-            if( cc < (int)(c*100)){
-                int p = walk_manager->intervalWithMinStep();
-                if( p != exec_interval ) return p;
-            }
-            return walk_manager->intervalWithMaxWalks();
+        /* Bytes of the shard files of interval p, the input of the walk cost model. */
+        size_t interval_bytes(int p) {
+            size_t bytes = 0;
+            std::string adjname = filename_shard_adj(base_filename, p, nshards);
+            if (file_exists(adjname)) bytes += get_filesize(adjname);
+#ifndef DYNAMICEDATA
+            std::string edataname = filename_shard_edata<EdgeDataType>(base_filename, p, nshards);
+            if (file_exists(edataname + ".size")) bytes += get_shard_edata_filesize<EdgeDataType>(edataname);
+#else
+            std::string edataname = filename_shard_edata<int>(base_filename, p, nshards);
+            if (file_exists(edataname + ".size")) bytes += get_shard_edata_filesize<int>(edataname);
+#endif
+            return bytes;
         }
 
         void loadIteratively(GraphChiProgram<VertexDataType, EdgeDataType, svertex_t> &userprogram, int niters ){
@@ -839,13 +931,11 @@ namespace graphchi {
                 /* -- move walks -- Rui */
                 for( int iter = 0; iter < niters; iter++ ){
                     for( int p = 0; p < nshards; p++){
-                         //exec_interval = NextInvlwithRandom( prob );
                          exec_interval = p;
                         //exec_interval = walk_manager->intervalWithMaxWeight();
                         walk_manager->printWalksDistribution( exec_interval );
                         metrics_entry mr = m.start_time();
                         runInterval(userprogram);
-                        walk_manager->minstep[exec_interval] = 0xfffffff;
                         m.stop_time(mr, "_in_run_interval");
                     }
                 } // For exec_interval
@@ -862,19 +952,128 @@ namespace graphchi {
 
                 /* Interval loop */
                 numIntervals = 0;
+                exec_interval = -1;
                 /* -- move walks -- Rui */
                 while( walk_manager->notFinish() ){
-                     //exec_interval = NextInvlwithRandom( prob );
-                     exec_interval = NextInvlwithMinStep( prob );
-                    //exec_interval = walk_manager->intervalWithMaxWeight();
+                    metrics_entry ms = m.start_time();
+                    exec_interval = walk_scheduler->next_interval( *walk_manager, exec_interval );
+                    m.stop_time(ms, "_schedule");
                     walk_manager->printWalksDistribution( exec_interval );
                     metrics_entry mr = m.start_time();
                     runInterval(userprogram);
-                    walk_manager->minstep[exec_interval] = 0xfffffff;
                     m.stop_time(mr, "_in_run_interval");
                 } // For exec_interval
         }
 
+        /**
+         * Loads the whole graph once for the in-memory mode. Every vertex
+         * gets its in-edges and then its out-edges in one edge array, laid
+         * out by vertex id like CSC and CSR, so no window has to be
+         * determined and nothing is reloaded. The memory shards of all
+         * intervals stay loaded and the edges of both directions point
+         * into their edge data, so an edge value is shared by its two
+         * endpoints.
+         */
+        void load_inmemory_graph() {
+            metrics_entry me = m.start_time();
+            vid_t nv = (vid_t) num_vertices();
+            sub_interval_st = 0;
+            sub_interval_en = nv - 1;
+            degree_handler->load(0, nv - 1);
+            
+            size_t num_edges = 0;
+            for(vid_t v=0; v < nv; v++) {
+                degree d = degree_handler->get_degree(v);
+                num_edges += d.indegree * store_inedges + d.outdegree * (!disable_outedges);
+            }
+            inmemory_edata = (graphchi_edge<EdgeDataType> *) malloc(num_edges * sizeof(graphchi_edge<EdgeDataType>));
+            inmemory_vertices.assign(nv, svertex_t());
+            size_t ecounter = 0;
+            for(vid_t v=0; v < nv; v++) {
+                degree d = degree_handler->get_degree(v);
+                int inc = d.indegree;
+                int outc = d.outdegree * (!disable_outedges);
+                inmemory_vertices[v] = svertex_t(v, &inmemory_edata[ecounter], &inmemory_edata[ecounter + inc * store_inedges], inc, outc);
+                if (disable_outedges) {
+                    inmemory_vertices[v].outc = d.outdegree;
+                }
+                inmemory_vertices[v].scheduled = true;
+                ecounter += inc * store_inedges + outc;
+            }
+            
+            for(int p=0; p < nshards; p++) {
+                exec_interval = p;
+                memshard_t * shard = create_memshard(get_interval_start(p), get_interval_end(p));
+                shard->only_adjacency = only_adjacency;
+                shard->load();
+                shard->load_vertices(0, nv - 1, inmemory_vertices, true, !disable_outedges);
+                inmemory_shards.push_back(shard);
+            }
+            if (!disable_vertexdata_storage) {
+                vertex_data_handler->load(0, nv - 1);
+            }
+            iomgr->wait_for_reads();
+            load_alias_tables(inmemory_vertices, 0);
+            
+            /* Without edge writes the updates cannot race on edge data */
+            if (!modifies_inedges && !modifies_outedges) {
+                for(vid_t v=0; v < nv; v++) inmemory_vertices[v].parallel_safe = true;
+            }
+            m.stop_time(me, "inmemory_load");
+            logstream(LOG_INFO) << "Loaded " << nv << " vertices and " << num_edges << " edges into memory." << std::endl;
+        }
+        
+        /**
+         * Releases the in-memory graph, writing the modified edge data back
+         * if set_save_edgesfiles_after_inmemmode() was set or the mode was
+         * chosen automatically, as the out-of-core mode would have kept
+         * the edge writes.
+         */
+        void release_inmemory_graph() {
+            for(int p=0; p < (int)inmemory_shards.size(); p++) {
+                if (save_edgesfiles_after_inmemmode || inmemory_auto) {
+                    inmemory_shards[p]->commit(modifies_inedges, modifies_outedges & !disable_outedges);
+                }
+                delete inmemory_shards[p];
+            }
+            inmemory_shards.clear();
+            iomgr->wait_for_writes();
+            inmemory_vertices.clear();
+            if (inmemory_edata != NULL) free(inmemory_edata);
+            inmemory_edata = NULL;
+        }
+        
+        /**
+         * In-memory version of loadOnDemand(): the whole graph is one
+         * window, so a pass over it runs every walk to its end.
+         */
+        void runInMemory(GraphChiProgram<VertexDataType, EdgeDataType, svertex_t> &userprogram) {
+            chicontext.filename = base_filename;
+            chicontext.nvertices = num_vertices();
+            if (!only_adjacency) chicontext.nedges = num_edges();
+            chicontext.execthreads = exec_threads;
+            chicontext.reset_deltas(exec_threads);
+            
+            load_inmemory_graph();
+            vid_t nv = (vid_t) num_vertices();
+            userprogram.before_exec_interval(0, nv - 1, chicontext);
+            walk_manager->visits.begin(0, nv - 1);
+            metrics_entry me = m.start_time();
+            while( walk_manager->notFinish() ){
+                exec_updates(userprogram, inmemory_vertices);
+                load_after_updates(inmemory_vertices);
+            }
+            m.stop_time(me, "inmemory_exec");
+            if (!disable_vertexdata_storage) {
+                walk_manager->visits.flush(inmemory_vertices);
+                save_vertices(inmemory_vertices);
+            } else {
+                walk_manager->visits.reset();
+            }
+            userprogram.after_exec_interval(0, nv - 1, chicontext);
+            release_inmemory_graph();
+        }
+
         /**
          * Run GraphChi program, specified as a template 
          * parameter. 
@@ -915,6 +1114,12 @@ namespace graphchi {
         
             initialize_before_run();
             
+            /* A graph sharded with weighted 1 has alias tables, and its walks draw out-edges by weight */
+            if (aliases == NULL && alias_table::exists(base_filename, nshards)) {
+                aliases = new alias_table(base_filename, intervals);
+                logstream(LOG_INFO) << "Found alias tables, out-edges are drawn by weight." << std::endl;
+            }
+            chicontext.aliases = aliases;
             
             /* Setup */
             if (sliding_shards.size() == 0) {
@@ -926,6 +1131,14 @@ namespace graphchi {
                 logstream(LOG_DEBUG) << "Engine being restarted, do not reinitialize." << std::endl;
             }
                 
+            /* Option inmemory: 1 always, 0 never (default), -1 if the graph fits in membudget_mb */
+            int inmemory_option = get_option_int("inmemory", 0);
+            inmemory = (inmemory_option < 0 ? fits_in_memory() : inmemory_option == 1);
+            inmemory_auto = inmemory && inmemory_option < 0;
+            logstream(LOG_INFO) << "Running " << (inmemory ? "in memory" : "out of core") << " (inmemory = " << inmemory_option
+                << "), the whole graph needs about " << inmemory_bytes() / 1024 / 1024 << " MB, membudget_mb = " << membudget_mb << std::endl;
+            m.set("inmemory", (size_t)inmemory);
+                
             initialize_scheduler();
             omp_set_nested(1);
             
@@ -939,18 +1152,31 @@ namespace graphchi {
             /* Print configuration */
             //print_config();
             
+            /* Walk scheduling */
+            std::vector<size_t> shardbytes(nshards);
+            for(int p=0; p < nshards; p++) shardbytes[p] = interval_bytes(p);
+            if (walk_scheduler != NULL) delete walk_scheduler;
+            if (walk_cost != NULL) delete walk_cost;
+            walk_cost = new walkCostModel(shardbytes, get_option_int("walk.io_mbps", 100) * 1024.0 * 1024.0);
+            walk_scheduler = create_walk_scheduler(nshards, *walk_cost, prob);
+
             /*main loop*/
             m.start_time("_startwalks");
             userprogram.startWalks(*walk_manager);
             m.stop_time("_startwalks");
             
-            loadOnDemand(userprogram, prob);
+            if (is_inmemory_mode()) {
+                runInMemory(userprogram);
+            } else {
+                loadOnDemand(userprogram, prob);
+            }
             // loadIteratively(userprogram, niters);
             
             m.stop_time("runtime");
             
             m.set("updates", nupdates);
             m.set("work", work);
+            m.set("walk_steps", (size_t)walk_manager->totalSteps());
             m.set("nvertices", num_vertices());
             m.set("execthreads", (size_t)exec_threads);
             m.set("loadthreads", (size_t)load_threads);
@@ -978,6 +1204,7 @@ namespace graphchi {
             if (modifies_inedges || modifies_outedges) {
                 iomgr->commit_cached_blocks();
             }
+            iomgr->get_block_cache().report(m);
         }
         
         virtual void iteration_finished() {
@@ -1110,7 +1337,7 @@ namespace graphchi {
                     for(int i=0; i < (int) (len / sizeof(ET)); i++) {
                         buf[i] = zerovalue;
                     }
-                    write_compressed(f, buf, len);
+                    write_compressed(f, buf, len, iomgr->get_block_codec());
                     close(f);
                     
 #ifdef DYNAMICEDATA
@@ -0,0 +1,76 @@
+#ifndef DEF_GRAPHCHI_EDATACODEC
+#define DEF_GRAPHCHI_EDATACODEC
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+
+#include "api/chifilenames.hpp"
+#include "logger/logger.hpp"
+#include "util/cmdopts.hpp"
+#include "util/ioutil.hpp"
+
+namespace graphchi {
+
+    /**
+     * Codec of the edge data blocks of a graph. It is chosen with the
+     * option edata.codec (zlib, none, lz4 or zstd) when the graph is
+     * sharded and kept in a small side file next to the graph, which is
+     * missing for zlib. An engine writes blocks with the codec of the
+     * graph unless edata.codec is given again; every block records its
+     * own codec, so a graph can be switched at any time and its blocks
+     * are converted as they are written.
+     */
+    static VARIABLE_IS_NOT_USED block_codec_t parse_block_codec(std::string name) {
+        block_codec_t codecs[] = { BLOCK_CODEC_ZLIB, BLOCK_CODEC_NONE, BLOCK_CODEC_LZ4, BLOCK_CODEC_ZSTD };
+        for(int i=0; i < 4; i++) {
+            if (name != block_codec_name(codecs[i])) continue;
+            if (!block_codec_available(codecs[i])) {
+                logstream(LOG_FATAL) << "Block codec " << name << " was not built in, rebuild with "
+                    << (codecs[i] == BLOCK_CODEC_LZ4 ? "GRAPHCHI_LZ4" : "GRAPHCHI_ZSTD") << "." << std::endl;
+                assert(false);
+            }
+            return codecs[i];
+        }
+        logstream(LOG_FATAL) << "Unknown edata.codec " << name << ", expected zlib, none, lz4 or zstd." << std::endl;
+        assert(false);
+        return BLOCK_CODEC_ZLIB;
+    }
+
+    static VARIABLE_IS_NOT_USED block_codec_t read_edata_codec(std::string basefilename) {
+        FILE * f = fopen(filename_edata_codec(basefilename).c_str(), "r");
+        if (f == NULL) return BLOCK_CODEC_ZLIB;
+        char name[64];
+        if (fscanf(f, "%63s", name) != 1) {
+            logstream(LOG_FATAL) << "Could not read " << filename_edata_codec(basefilename) << std::endl;
+            assert(false);
+        }
+        fclose(f);
+        return parse_block_codec(name);
+    }
+
+    static VARIABLE_IS_NOT_USED void write_edata_codec(std::string basefilename, block_codec_t codec) {
+        std::string fname = filename_edata_codec(basefilename);
+        if (codec == BLOCK_CODEC_ZLIB) {
+            remove(fname.c_str());
+            return;
+        }
+        FILE * f = fopen(fname.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_FATAL) << "Could not write " << fname << " error: " << strerror(errno) << std::endl;
+        }
+        assert(f != NULL);
+        fprintf(f, "%s\n", block_codec_name(codec));
+        fclose(f);
+    }
+
+    /* Codec for writing the blocks of a graph: edata.codec if given, else the recorded one. */
+    static VARIABLE_IS_NOT_USED block_codec_t edata_codec_option(std::string basefilename) {
+        std::string name = get_option_string("edata.codec", "");
+        if (name == "") return read_edata_codec(basefilename);
+        return parse_block_codec(name);
+    }
+}
+
+#endif
@@ -49,9 +49,13 @@
 #include "util/synchronized_queue.hpp"
 #include "util/ioutil.hpp"
 #include "util/cmdopts.hpp"
+#include "io/uringio.hpp"
 
 #define CACHED_SESSION_ID (-1)
 
+/* Alignment of buffers, offsets and lengths of O_DIRECT reads */
+#define DIRECT_IO_ALIGNMENT 4096
+
 
 namespace graphchi {
     
@@ -64,6 +68,7 @@ namespace graphchi {
         std::string filename;    
         std::vector<int> readdescs;
         std::vector<int> writedescs;
+        int directdesc; // O_DIRECT descriptor for io_uring reads, -1 if none
         
         int start_mplex;
         bool open;
@@ -123,8 +128,25 @@ namespace graphchi {
         int mplex;
     };
     
+    /**
+     * A task submitted to the io_uring, which is queued again after a
+     * short transfer. A direct read covers the aligned range around the
+     * task in a registered buffer and copies the task's bytes out of it.
+     */
+    struct uring_task {
+        iotask task;
+        int fd;
+        int bufindex;   // registered buffer of a direct read, -1 if none
+        size_t start;   // file offset of the transfer
+        size_t length;  // bytes to transfer
+        size_t skip;    // bytes of the registered buffer before the task's data
+        size_t done;
+    };
+    
     // Forward declaration
     static void * io_thread_loop(void * _info);
+    static void * uring_thread_loop(void * _iomgr);
+    static void finish_iotask(iotask & task, volatile int * pending);
     
     struct stripe_chunk {
         int mplex_thread;
@@ -134,11 +156,16 @@ namespace graphchi {
     };
     
     struct cached_block {
+        std::string filename;
         size_t len;
         void * data;
         bool was_compressed;
+        bool dirty;       // Newer than the block file, written back on eviction
+        bool referenced;  // CLOCK reference bit, set on every hit
+        int pins;         // Shards using the data in place
         
-        cached_block(size_t len, void * data, bool was_compressed) : len(len), data(data), was_compressed(was_compressed) {}
+        cached_block(std::string filename, size_t len, void * data, bool was_compressed, bool dirty) : filename(filename), len(len), data(data),
+            was_compressed(was_compressed), dirty(dirty), referenced(false), pins(0) {}
         
         ~cached_block() {
             free(data);
@@ -148,26 +175,65 @@ namespace graphchi {
     
     
     /**
-      * Simple cache attached to the io manager. 
+      * Cache of edge data blocks attached to the io manager. Shards offer
+      * it the blocks they are done with instead of writing them, and on a
+      * hit use the cached data in place, pinning the block until they
+      * release it. When a block does not fit, others are replaced by CLOCK:
+      * the hand sweeps the blocks, clearing reference bits, and evicts the
+      * first unpinned block without one, writing it back if it is dirty.
+      * New blocks are placed behind the hand with the bit clear, so they
+      * get a full sweep to be used again. If two sweeps find nothing to
+      * evict, the offered block is not taken.
       */
     class block_cache {
         size_t cache_budget_bytes;
         size_t cache_size;
         mutex lock;  // TODO: read-write-lock
-        bool full;
         std::map<std::string, cached_block *> cachemap;
+        std::map<void *, cached_block *> datamap;
+        std::vector<cached_block *> clock;
+        size_t hand;
+        stripedio * iomgr;
         
-        size_t hits, misses;
+        size_t hits, misses, evictions, writebacks, rejections;
+        
+        void write_back(cached_block * block);
+        
+        /* Evicts blocks until len more bytes fit; lock is held. */
+        bool make_room(size_t len) {
+            size_t swept = 0;
+            while (cache_size + len > cache_budget_bytes && swept < 2 * clock.size()) {
+                if (hand >= clock.size()) hand = 0;
+                cached_block * block = clock[hand];
+                swept++;
+                if (block->pins > 0) {
+                    hand++;
+                } else if (block->referenced) {
+                    block->referenced = false;
+                    hand++;
+                } else {
+                    if (block->dirty) write_back(block);
+                    clock.erase(clock.begin() + hand);
+                    cachemap.erase(block->filename);
+                    datamap.erase(block->data);
+                    cache_size -= block->len;
+                    delete block;
+                    evictions++;
+                    swept = 0;
+                }
+            }
+            return cache_size + len <= cache_budget_bytes;
+        }
         
     public:
     
-        block_cache(size_t cache_budget_bytes) : cache_budget_bytes(cache_budget_bytes), cache_size(0), full(false) {
-            hits = misses = 0;
+        block_cache(size_t cache_budget_bytes, stripedio * iomgr) : cache_budget_bytes(cache_budget_bytes), cache_size(0), hand(0), iomgr(iomgr) {
+            hits = misses = evictions = writebacks = rejections = 0;
         }
         
         ~block_cache() {
             if (hits + misses > 0) {
-                logstream(LOG_INFO) << "Cache stats: hits=" << hits << " misses=" << misses << std::endl;
+                logstream(LOG_INFO) << "Cache stats: hits=" << hits << " misses=" << misses << " evictions=" << evictions << std::endl;
                 logstream(LOG_INFO) << " -- in total had " << (cache_size / 1024 / 1024) << " MB in cache." << std::endl;
             }
             std::map<std::string, cached_block *>::iterator it = cachemap.begin();
@@ -178,47 +244,82 @@ namespace graphchi {
         
          
         
-        bool consider_caching(std::string filename, void * data, size_t len, bool was_compresssed) {
-            bool did_cache = false;
-            if (!full && len + cache_size <= cache_budget_bytes) {
-                lock.lock();
-                if (len + cache_size <= cache_budget_bytes) {
-                    cache_size += len;
-                    did_cache = true;
-                    if (cachemap.size() % 40 == 0) {
-                        logstream(LOG_DEBUG) << "Cache size: " << cache_size << " / " << cache_budget_bytes << std::endl;
-                    }
-                    cachemap.insert(std::pair<std::string, cached_block*>(filename, new cached_block(len, data, was_compresssed)));
-                }
-                if (cache_size > cache_budget_bytes) {
-                    full = true; // If full, we can avoid locking
+        /**
+         * Offers a block the caller is done with. If it is taken the cache
+         * owns data; dirty tells if it still has to be written to the file.
+         */
+        bool consider_caching(std::string filename, void * data, size_t len, bool was_compresssed, bool dirty=true) {
+            if (len > cache_budget_bytes) return false;
+            lock.lock();
+            bool did_cache = cachemap.find(filename) == cachemap.end() && make_room(len);
+            if (did_cache) {
+                cache_size += len;
+                if (cachemap.size() % 40 == 0) {
+                    logstream(LOG_DEBUG) << "Cache size: " << cache_size << " / " << cache_budget_bytes << std::endl;
                 }
-                lock.unlock();
+                cached_block * block = new cached_block(filename, len, data, was_compresssed, dirty);
+                cachemap.insert(std::pair<std::string, cached_block*>(filename, block));
+                datamap.insert(std::pair<void*, cached_block*>(data, block));
+                if (hand > clock.size()) hand = clock.size();
+                clock.insert(clock.begin() + hand, block);
+                hand++;
+            } else {
+                rejections++;
             }
+            lock.unlock();
             return did_cache;
         }
         
+        /* Returns the data of a cached block, which stays pinned until release_cached(), or NULL. */
         void * get_cached(std::string filename) {
-            bool acquired_mutex = false;
-            if (!full) {
-                acquired_mutex = true;
-                lock.lock();
-            }
-            
             void * ret = NULL;
+            lock.lock();
             std::map<std::string, cached_block *>::iterator lookup = cachemap.find(filename);
             if (lookup != cachemap.end()) {
-                ret =  lookup->second->data;
+                cached_block * block = lookup->second;
+                block->referenced = true;
+                block->pins++;
+                ret = block->data;
                 hits++;
             } else {
                 misses++;
             }
-            
-            if (acquired_mutex) {
-                lock.unlock();
-            }
+            lock.unlock();
             return ret;
         }
+        
+        /* Unpins a block taken with get_cached(); modified marks it dirty. */
+        void release_cached(void * data, bool modified) {
+            lock.lock();
+            std::map<void *, cached_block *>::iterator lookup = datamap.find(data);
+            assert(lookup != datamap.end());
+            cached_block * block = lookup->second;
+            assert(block->pins > 0);
+            block->pins--;
+            if (modified) block->dirty = true;
+            lock.unlock();
+        }
+        
+        /* Writes all dirty blocks to their files; they stay cached. */
+        void write_dirty_blocks() {
+            lock.lock();
+            std::map<std::string, cached_block *>::iterator it = cachemap.begin();
+            for(; it != cachemap.end(); ++it) {
+                if (it->second->dirty) write_back(it->second);
+            }
+            lock.unlock();
+        }
+        
+        void report(metrics &m) {
+            if (cache_budget_bytes == 0) return;
+            m.set("blockcache.hits", hits);
+            m.set("blockcache.misses", misses);
+            m.set("blockcache.evictions", evictions);
+            m.set("blockcache.writebacks", writebacks);
+            m.set("blockcache.rejections", rejections);
+            if (hits + misses > 0) m.set("blockcache.hitrate", (double)hits / (hits + misses));
+        }
+        
         friend class stripedio;
     };
     
@@ -240,9 +341,24 @@ namespace graphchi {
         metrics &m;        
         
         int niothreads; // threads per mplex
+        // Round-robin counter picking the thread of a stripe, so I/O draws no random numbers
+        unsigned nextiothread;
         
         block_cache cache;
         
+        // Codec of the compressed blocks written, they are read with their own
+        block_codec_t codec;
+        
+        // io_uring backend, NULL when the threads do all I/O
+        uring_ring * uring;
+        pthread_t uring_thread;
+        volatile int uring_pending_reads;
+        volatile int uring_pending_writes;
+        bool direct_reads;
+        size_t fixedbufsize;
+        std::vector<char *> fixedbufs;
+        std::vector<int> freebufs;
+        mutex buflock;
         
     private:
         // MMAP 
@@ -250,7 +366,7 @@ namespace graphchi {
         std::map<std::string, mmap_info> mmaped;
         
     public:
-        stripedio( metrics &_m) : m(_m), cache(0) {
+        stripedio( metrics &_m) : m(_m), cache(0, this), codec(BLOCK_CODEC_ZLIB) {
             stripesize = get_option_int("io.stripesize", 1024 * 1024 / 2);
 
             multiplex = get_option_int("multiplex", 1);
@@ -266,6 +382,7 @@ namespace graphchi {
             
             // Start threads (niothreads is now threads per multiplex)
             niothreads = get_option_int("niothreads", 1);
+            nextiothread = 0;
             m.set("niothreads", (size_t)niothreads);
        
             // logstream(LOG_DEBUG) << "Start io-manager with " << niothreads << " threads." << std::endl;
@@ -296,9 +413,80 @@ namespace graphchi {
                     k++;
                 }
             }
+            
+            /* With io.backend uring, asynchronous reads and writes of uncompressed
+               files go to an io_uring; the threads keep compressed blocks and
+               take over everything if io_uring cannot be set up. */
+            uring = NULL;
+            uring_pending_reads = uring_pending_writes = 0;
+            direct_reads = false;
+            fixedbufsize = 0;
+            std::string backend = get_option_string("io.backend", "threads");
+            if (backend == "uring") {
+                start_uring();
+            } else if (backend != "threads") {
+                logstream(LOG_FATAL) << "Unknown io.backend " << backend << ", expected threads or uring." << std::endl;
+                assert(false);
+            }
+            m.set("io_backend", std::string(uring != NULL ? "uring" : "threads"));
+        }
+        
+        /**
+         * Sets up the io_uring of io.uring.depth entries and its completion
+         * thread. With io.uring.direct, io.uring.buffers aligned buffers of
+         * io.uring.bufsize bytes are registered with the ring, and reads of
+         * read-only files that fit in one go through O_DIRECT descriptors
+         * into them.
+         */
+        void start_uring() {
+            uring = new uring_ring();
+            if (!uring->init(get_option_int("io.uring.depth", 128))) {
+                logstream(LOG_WARNING) << "Could not set up io_uring: " << strerror(errno) << ", using I/O threads." << std::endl;
+                delete uring;
+                uring = NULL;
+                return;
+            }
+            if (get_option_int("io.uring.direct", 0)) {
+                int nbufs = get_option_int("io.uring.buffers", 16);
+                fixedbufsize = get_option_long("io.uring.bufsize", 2 * 1024 * 1024);
+                fixedbufsize = (fixedbufsize + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+                std::vector<struct iovec> iov(nbufs);
+                for(int i=0; i < nbufs; i++) {
+                    void * buf = NULL;
+                    int ret = posix_memalign(&buf, DIRECT_IO_ALIGNMENT, fixedbufsize);
+                    assert(ret == 0);
+                    fixedbufs.push_back((char *) buf);
+                    freebufs.push_back(i);
+                    iov[i].iov_base = buf;
+                    iov[i].iov_len = fixedbufsize;
+                }
+                direct_reads = nbufs > 0 && uring->register_buffers(iov);
+                if (!direct_reads) {
+                    logstream(LOG_WARNING) << "Could not register io_uring buffers: " << strerror(errno) << ", reading through the page cache." << std::endl;
+                }
+            }
+            int ret = pthread_create(&uring_thread, NULL, uring_thread_loop, this);
+            assert(ret == 0);
+            logstream(LOG_INFO) << "I/O through io_uring of depth " << uring->depth()
+                << (direct_reads ? ", with direct reads of read-only files." : ".") << std::endl;
         }
         
         ~stripedio() {
+            if (uring != NULL) {
+                while (uring_pending_reads > 0 || uring_pending_writes > 0) {
+                    usleep(1000);
+                }
+                uring->nop(0); // Stops the completion thread
+                uring->submit();
+                pthread_join(uring_thread, NULL);
+                delete uring;
+                uring = NULL;
+            }
+            for(int i=0; i < (int)fixedbufs.size(); i++) {
+                free(fixedbufs[i]);
+            }
+            fixedbufs.clear();
+            
             int mplex = (int) thread_infos.size();
             // Quit all threads
             for(int i=0; i<mplex; i++) {
@@ -331,7 +519,15 @@ namespace graphchi {
         
         void set_cache_budget(size_t c) {
             cache.cache_budget_bytes = c;
-            cache.full = false;
+        }
+        
+        void set_block_codec(block_codec_t c) {
+            codec = c;
+            m.set("edata_codec", std::string(block_codec_name(c)));
+        }
+        
+        block_codec_t get_block_codec() {
+            return codec;
         }
         
         block_cache & get_block_cache() {
@@ -342,16 +538,7 @@ namespace graphchi {
           * Write to disk cached blocks.
           */
         void commit_cached_blocks() {
-            std::map<std::string, cached_block *>::iterator it = cache.cachemap.begin();
-            for(; it != cache.cachemap.end(); ++it) {
-                std::string fname = it->first;
-                cached_block * block = it->second;
-                
-                int session = open_session(fname, false, block->was_compressed);
-                pwritea_now(session, block->data, block->len, 0);
-                close_session(session);
-            }
-
+            cache.write_dirty_blocks();
         }
         
         bool multiplexed() {
@@ -423,6 +610,13 @@ namespace graphchi {
                     }
                 }
             }
+            iodesc->directdesc = -1;
+#ifdef O_DIRECT
+            if (readonly && direct_reads && multiplex == 1) {
+                // Not every file system supports O_DIRECT; then reads go through the page cache
+                iodesc->directdesc = open(filename.c_str(), O_RDONLY | O_DIRECT);
+            }
+#endif
             iodesc->filename = filename;
             return session_id;
         }
@@ -441,14 +635,12 @@ namespace graphchi {
                 for(std::vector<int>::iterator it=iodesc->readdescs.begin(); it!=iodesc->readdescs.end(); ++it) {
                     close(*it);
                 }
+                if (iodesc->directdesc >= 0) {
+                    close(iodesc->directdesc);
+                }
             }
         }
         
-        void first_pass_finished() {
-            // Optimization
-            cache.full = true;
-        }
-        
         std::string & get_session_filename(int session) {
             return sessions[session]->filename;
         }
@@ -467,7 +659,7 @@ namespace graphchi {
                 size_t blockoff = idx % stripesize;
                 size_t blocklen = std::min(stripesize-blockoff, end-idx);
                 
-                int mplex_thread = (int) mplex_for_offset(session, idx) * niothreads + (int) (random() % niothreads);
+                int mplex_thread = (int) mplex_for_offset(session, idx) * niothreads + (int) (__sync_fetch_and_add(&nextiothread, 1) % niothreads);
                 stripelist.push_back(stripe_chunk(mplex_thread, bufoff, blocklen));
                 
                 bufoff += blocklen;
@@ -478,6 +670,7 @@ namespace graphchi {
         
         template <typename T>
         void preada_async(int session,  T * tbuf, size_t nbytes, size_t off, volatile int * doneptr = NULL) {
+            m.add("io_bytes_read", (double)nbytes);
             std::vector<stripe_chunk> stripelist = stripe_offsets(session, nbytes, off);
             if (compressed_session(session)) {
                 assert(stripelist.size() == 1);
@@ -486,14 +679,20 @@ namespace graphchi {
             refcountptr * refptr = new refcountptr((char*)tbuf, (int)stripelist.size());
             for(int i=0; i<(int)stripelist.size(); i++) {
                 stripe_chunk chunk = stripelist[i];
-                __sync_add_and_fetch(&thread_infos[chunk.mplex_thread]->pending_reads, 1);
                 iotask task = iotask(this, READ, sessions[session]->readdescs[chunk.mplex_thread],
                                      session,
                                      refptr, chunk.len, chunk.offset+off, chunk.offset, false,
                                      compressed_session(session));
                 task.doneptr = doneptr;
-                mplex_readtasks[chunk.mplex_thread].push(task);
+                if (uses_uring(session)) {
+                    __sync_add_and_fetch(&uring_pending_reads, 1);
+                    queue_uring(new_uring_task(task, session), false);
+                } else {
+                    __sync_add_and_fetch(&thread_infos[chunk.mplex_thread]->pending_reads, 1);
+                    mplex_readtasks[chunk.mplex_thread].push(task);
+                }
             }
+            if (uses_uring(session)) uring->submit();
         }
        
         
@@ -504,6 +703,119 @@ namespace graphchi {
             return sessions[session]->compressed;
         }
         
+        /* Compressed blocks are inflated by the I/O threads also with io_uring. */
+        bool uses_uring(int session) {
+            return uring != NULL && !compressed_session(session);
+        }
+        
+        int acquire_fixedbuf() {
+            int b = -1;
+            buflock.lock();
+            if (!freebufs.empty()) {
+                b = freebufs.back();
+                freebufs.pop_back();
+            }
+            buflock.unlock();
+            return b;
+        }
+        
+        void release_fixedbuf(int b) {
+            buflock.lock();
+            freebufs.push_back(b);
+            buflock.unlock();
+        }
+        
+        /* A read goes direct if the session has an O_DIRECT descriptor and a registered buffer is free. */
+        uring_task * new_uring_task(iotask & task, int session) {
+            uring_task * t = new uring_task();
+            t->task = task;
+            t->fd = task.fd;
+            t->bufindex = -1;
+            t->start = task.offset;
+            t->length = task.length;
+            t->skip = 0;
+            t->done = 0;
+            int directdesc = sessions[session]->directdesc;
+            if (task.action == READ && directdesc >= 0) {
+                size_t st = task.offset / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+                size_t en = (task.offset + task.length + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+                if (en - st <= fixedbufsize && (t->bufindex = acquire_fixedbuf()) >= 0) {
+                    t->fd = directdesc;
+                    t->start = st;
+                    t->length = en - st;
+                    t->skip = task.offset - st;
+                }
+            }
+            return t;
+        }
+        
+        /* Queues the rest of the transfer of t; replaces is set when it is queued again after a completion. */
+        void queue_uring(uring_task * t, bool replaces) {
+            uint64_t userdata = (uint64_t)(uintptr_t) t;
+            unsigned len = (unsigned) (t->length - t->done);
+            if (t->task.action == WRITE) {
+                uring->write(t->fd, t->task.ptr->ptr + t->task.ptroffset + t->done, len, t->start + t->done, userdata, replaces);
+            } else if (t->bufindex >= 0) {
+                uring->read_fixed(t->fd, fixedbufs[t->bufindex] + t->done, len, t->start + t->done, t->bufindex, userdata, replaces);
+            } else {
+                uring->read(t->fd, t->task.ptr->ptr + t->task.ptroffset + t->done, len, t->start + t->done, userdata, replaces);
+            }
+        }
+        
+        /* Synchronous read or write through the io_uring, so it can go direct and does not queue behind the threads. */
+        void uring_now(BLOCK_ACTION action, int session, char * buf, size_t nbytes, size_t off) {
+            volatile int done = 1;
+            refcountptr * refptr = new refcountptr(buf, 1);
+            int fd = (action == READ ? sessions[session]->readdescs[threads.size()] : sessions[session]->writedescs[0]);
+            iotask task(this, action, fd, session, refptr, nbytes, off, 0, false, false);
+            task.doneptr = &done;
+            __sync_add_and_fetch(action == READ ? &uring_pending_reads : &uring_pending_writes, 1);
+            queue_uring(new_uring_task(task, session), false);
+            uring->submit();
+            while (done != 0) {
+                usleep(10);
+            }
+            if (action == WRITE) delete refptr; // Reads release it on completion
+        }
+        
+        /**
+         * Completion loop of the io_uring, run by a single thread. A direct
+         * read at the end of a file transfers less than its aligned length,
+         * which is fine as long as the task's bytes are in.
+         */
+        void uring_loop() {
+            while (true) {
+                uint64_t userdata;
+                int res;
+                uring->wait(userdata, res);
+                if (userdata == 0) break;
+                uring_task * t = (uring_task *) (uintptr_t) userdata;
+                if (res == -EINTR || res == -EAGAIN) {
+                    queue_uring(t, true);
+                    uring->submit();
+                    continue;
+                }
+                if (res <= 0) {
+                    logstream(LOG_FATAL) << "Could not " << (t->task.action == WRITE ? "write" : "read") << " " << t->length
+                        << " bytes at " << t->start << " of file-desc " << t->fd << ": " << (res < 0 ? strerror(-res) : "end of file") << std::endl;
+                    assert(false);
+                }
+                t->done += res;
+                size_t needed = (t->bufindex >= 0 ? t->skip + t->task.length : t->length);
+                if (t->done < needed) {
+                    queue_uring(t, true);
+                    uring->submit();
+                    continue;
+                }
+                if (t->bufindex >= 0) {
+                    memcpy(t->task.ptr->ptr + t->task.ptroffset, fixedbufs[t->bufindex] + t->skip, t->task.length);
+                    release_fixedbuf(t->bufindex);
+                }
+                finish_iotask(t->task, t->task.action == WRITE ? &uring_pending_writes : &uring_pending_reads);
+                delete t;
+            }
+        }
+        
        
         
         
@@ -518,16 +830,24 @@ namespace graphchi {
             }
             for(int i=0; i<(int)stripelist.size(); i++) {
                 stripe_chunk chunk = stripelist[i];
-                __sync_add_and_fetch(&thread_infos[chunk.mplex_thread]->pending_writes, 1);
-                mplex_writetasks[chunk.mplex_thread].push(iotask(this, WRITE, sessions[session]->writedescs[chunk.mplex_thread], session,
-                                                                 refptr, chunk.len, chunk.offset+off, chunk.offset, free_after, compressed_session(session),
-                                                                        close_fd));
+                iotask task = iotask(this, WRITE, sessions[session]->writedescs[chunk.mplex_thread], session,
+                                     refptr, chunk.len, chunk.offset+off, chunk.offset, free_after, compressed_session(session),
+                                     close_fd);
+                if (uses_uring(session)) {
+                    __sync_add_and_fetch(&uring_pending_writes, 1);
+                    queue_uring(new_uring_task(task, session), false);
+                } else {
+                    __sync_add_and_fetch(&thread_infos[chunk.mplex_thread]->pending_writes, 1);
+                    mplex_writetasks[chunk.mplex_thread].push(task);
+                }
             }
+            if (uses_uring(session)) uring->submit();
         }
         
         template <typename T>
         void preada_now(int session,  T * tbuf, size_t nbytes, size_t off, bool dupfd=false) {
             metrics_entry me = m.start_time();
+            m.add("io_bytes_read", (double)nbytes);
             if (compressed_session(session)) {
                 // Compressed sessions do not support multiplexing for now
                 assert(off == 0);
@@ -558,6 +878,8 @@ namespace graphchi {
                     usleep(5000);
                 }
                 delete refptr;
+            } else if (uses_uring(session)) {
+                uring_now(READ, session, (char*)tbuf, nbytes, off);
             } else {
                 if (!dupfd) {
                     preada(sessions[session]->readdescs[threads.size()], tbuf, nbytes, off);
@@ -578,11 +900,16 @@ namespace graphchi {
             if (compressed_session(session)) {
                 // Compressed sessions do not support multiplexing for now
                 assert(off == 0);
-                write_compressed(sessions[session]->writedescs[0], tbuf, nbytes);
+                write_compressed(sessions[session]->writedescs[0], tbuf, nbytes, codec);
                 m.stop_time(me, "pwritea_now", false);
 
                 return;
             }
+            if (uses_uring(session) && multiplex == 1) {
+                uring_now(WRITE, session, (char*)tbuf, nbytes, off);
+                m.stop_time(me, "pwritea_now", false);
+                return;
+            }
             std::vector<stripe_chunk> stripelist = stripe_offsets(session, nbytes, off);
             size_t checklen=0;
             
@@ -659,6 +986,9 @@ namespace graphchi {
                     loops++;
                 }
             }
+            while(uring_pending_reads > 0) {
+                usleep(100);
+            }
             m.stop_time(me, "stripedio_wait_for_reads", false);
         }
         
@@ -670,6 +1000,9 @@ namespace graphchi {
                     usleep(10000);
                 }
             }
+            while(uring_pending_writes > 0) {
+                usleep(100);
+            }
             m.stop_time(me, "stripedio_wait_for_writes", false);
         }
         
@@ -743,22 +1076,11 @@ namespace graphchi {
                     
                     if (task.compressed) {
                         assert(task.offset == 0);
-                        write_compressed(task.fd, task.ptr->ptr, task.length);
+                        write_compressed(task.fd, task.ptr->ptr, task.length, task.iomgr->get_block_codec());
                     } else {
                         pwritea(task.fd, task.ptr->ptr + task.ptroffset, task.length, task.offset);
                     }
-                    if (task.free_after) {
-                        // Threead-safe method of memory managment - ugly!
-                        if (__sync_sub_and_fetch(&task.ptr->count, 1) == 0) {
-                            free(task.ptr->ptr);
-                            delete task.ptr;
-                            if (task.closefd) {
-                                task.iomgr->close_session(task.session);
-                            }
-                        }
-                    }
-                   
-                    __sync_sub_and_fetch(&info->pending_writes, 1);
+                    finish_iotask(task, &info->pending_writes);
                     info->m->stop_time(me, "commit_thr");
                 } else {
                     if (task.compressed) {
@@ -768,16 +1090,7 @@ namespace graphchi {
                     } else {
                         preada(task.fd, task.ptr->ptr+task.ptroffset, task.length, task.offset);
                     }
-                    __sync_sub_and_fetch(&info->pending_reads, 1);
-                    if (__sync_sub_and_fetch(&task.ptr->count, 1) == 0) {
-                        free(task.ptr);
-                        if (task.closefd) {
-                            task.iomgr->close_session(task.session);
-                        }
-                    }
-                }
-                if (task.doneptr != NULL) {
-                    __sync_sub_and_fetch(task.doneptr, 1);
+                    finish_iotask(task, &info->pending_reads);
                 }
             } else {
                 usleep(50000); // 50 ms
@@ -787,6 +1100,51 @@ namespace graphchi {
         return NULL;
     }
     
+    inline void block_cache::write_back(cached_block * block) {
+        int session = iomgr->open_session(block->filename, false, block->was_compressed);
+        iomgr->pwritea_now(session, block->data, block->len, 0);
+        iomgr->close_session(session);
+        block->dirty = false;
+        writebacks++;
+    }
+    
+    static void * uring_thread_loop(void * _iomgr) {
+        ((stripedio *) _iomgr)->uring_loop();
+        return NULL;
+    }
+    
+    /**
+     * Releases the buffer of a finished task, or its reference to it, and
+     * signals completion; pending counts the outstanding reads or writes
+     * of the thread or ring that did the task.
+     */
+    static void finish_iotask(iotask & task, volatile int * pending) {
+        if (task.action == WRITE) {
+            if (task.free_after) {
+                // Threead-safe method of memory managment - ugly!
+                if (__sync_sub_and_fetch(&task.ptr->count, 1) == 0) {
+                    free(task.ptr->ptr);
+                    delete task.ptr;
+                    if (task.closefd) {
+                        task.iomgr->close_session(task.session);
+                    }
+                }
+            }
+            __sync_sub_and_fetch(pending, 1);
+        } else {
+            __sync_sub_and_fetch(pending, 1);
+            if (__sync_sub_and_fetch(&task.ptr->count, 1) == 0) {
+                free(task.ptr);
+                if (task.closefd) {
+                    task.iomgr->close_session(task.session);
+                }
+            }
+        }
+        if (task.doneptr != NULL) {
+            __sync_sub_and_fetch(task.doneptr, 1);
+        }
+    }
+    
     
    
     static size_t get_filesize(std::string filename) {
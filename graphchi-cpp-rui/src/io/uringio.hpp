@@ -0,0 +1,223 @@
+#ifndef DEF_GRAPHCHI_URINGIO
+#define DEF_GRAPHCHI_URINGIO
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <vector>
+#include <algorithm>
+
+#include "logger/logger.hpp"
+#include "util/pthread_tools.hpp"
+
+/* The ring is driven with the raw system calls, so only the kernel headers are
+   needed; IORING_OP_READ came with Linux 5.6 along with IORING_FEAT_RW_CUR_POS. */
+#if defined(__linux__) && !defined(GRAPHCHI_DISABLE_IOURING)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define GRAPHCHI_IOURING
+#endif
+#endif
+
+namespace graphchi {
+
+    /**
+     * An io_uring instance for the I/O manager. Any thread may queue reads
+     * and writes, which go to the kernel in one system call per submit(),
+     * and a single thread reaps the completions with wait(). Requests in
+     * flight are kept below the size of the submission queue, half the
+     * completion queue, so no completion is ever dropped; a request queued
+     * again by the reaping thread after a short transfer replaces the one
+     * it just reaped and does not wait for room.
+     *
+     * Without io_uring support init() fails with ENOSYS and the I/O
+     * manager keeps to its threads.
+     */
+    class uring_ring {
+#ifdef GRAPHCHI_IOURING
+        int ringfd;
+        unsigned sq_entries, cq_entries;
+        void * sqmap, * cqmap;
+        size_t sqmaplen, cqmaplen;
+        struct io_uring_sqe * sqes;
+        size_t sqeslen;
+        unsigned * sq_tail, * sq_mask, * sq_array;
+        unsigned * cq_head, * cq_tail, * cq_mask;
+        struct io_uring_cqe * cqes;
+        unsigned unsubmitted;
+        volatile int inflight;
+        mutex sqlock;
+
+        static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+            return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+        }
+
+        /* Hands the queued requests to the kernel; sqlock is held. */
+        void flush() {
+            while (unsubmitted > 0) {
+                int ret = enter(ringfd, unsubmitted, 0, 0);
+                if (ret < 0) {
+                    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                        usleep(100);
+                        continue;
+                    }
+                    logstream(LOG_FATAL) << "io_uring submit failed: " << strerror(errno) << std::endl;
+                    assert(false);
+                }
+                unsubmitted -= ret;
+            }
+        }
+
+        void queue(uint8_t op, int fd, void * buf, unsigned len, uint64_t off, uint64_t userdata, int bufindex, bool replaces) {
+            sqlock.lock();
+            while (!replaces && inflight >= (int)sq_entries) {
+                flush();
+                usleep(50);
+            }
+            if (unsubmitted == sq_entries) flush();
+            unsigned tail = *sq_tail;
+            unsigned idx = tail & *sq_mask;
+            struct io_uring_sqe * sqe = &sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = op;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)buf;
+            sqe->len = len;
+            sqe->off = off;
+            sqe->user_data = userdata;
+            if (bufindex >= 0) sqe->buf_index = (uint16_t)bufindex;
+            sq_array[idx] = idx;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+            unsubmitted++;
+            __sync_add_and_fetch(&inflight, 1);
+            sqlock.unlock();
+        }
+
+    public:
+        uring_ring() : ringfd(-1), sqmap(NULL), cqmap(NULL), sqes(NULL), unsubmitted(0), inflight(0) {}
+
+        ~uring_ring() {
+            if (ringfd < 0) return;
+            munmap(sqes, sqeslen);
+            if (cqmap != sqmap) munmap(cqmap, cqmaplen);
+            munmap(sqmap, sqmaplen);
+            close(ringfd);
+        }
+
+        /* Sets up a ring of depth entries; false with errno set if the kernel refuses. */
+        bool init(unsigned depth) {
+            struct io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            ringfd = (int) syscall(__NR_io_uring_setup, depth, &p);
+            if (ringfd < 0) return false;
+            sq_entries = p.sq_entries;
+            cq_entries = p.cq_entries;
+
+            sqmaplen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            cqmaplen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+            if (p.features & IORING_FEAT_SINGLE_MMAP) {
+                sqmaplen = cqmaplen = std::max(sqmaplen, cqmaplen);
+            }
+            sqmap = mmap(NULL, sqmaplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+            if (sqmap == MAP_FAILED) {
+                int err = errno;
+                close(ringfd);
+                ringfd = -1;
+                errno = err;
+                return false;
+            }
+            cqmap = sqmap;
+            if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+                cqmap = mmap(NULL, cqmaplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+                assert(cqmap != MAP_FAILED);
+            }
+            sqeslen = p.sq_entries * sizeof(struct io_uring_sqe);
+            sqes = (struct io_uring_sqe *) mmap(NULL, sqeslen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+            assert((void*)sqes != MAP_FAILED);
+
+            char * sq = (char *) sqmap, * cq = (char *) cqmap;
+            sq_tail = (unsigned *) (sq + p.sq_off.tail);
+            sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+            sq_array = (unsigned *) (sq + p.sq_off.array);
+            cq_head = (unsigned *) (cq + p.cq_off.head);
+            cq_tail = (unsigned *) (cq + p.cq_off.tail);
+            cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+            cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+            return true;
+        }
+
+        unsigned depth() {
+            return sq_entries;
+        }
+
+        /* Registers buffers for read_fixed(), addressed by their index. */
+        bool register_buffers(std::vector<struct iovec> & iov) {
+            return syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_BUFFERS, &iov[0], (unsigned) iov.size()) == 0;
+        }
+
+        void read(int fd, void * buf, unsigned len, uint64_t off, uint64_t userdata, bool replaces=false) {
+            queue(IORING_OP_READ, fd, buf, len, off, userdata, -1, replaces);
+        }
+
+        /* Read into registered buffer bufindex; buf must lie within it. */
+        void read_fixed(int fd, void * buf, unsigned len, uint64_t off, int bufindex, uint64_t userdata, bool replaces=false) {
+            queue(IORING_OP_READ_FIXED, fd, buf, len, off, userdata, bufindex, replaces);
+        }
+
+        void write(int fd, void * buf, unsigned len, uint64_t off, uint64_t userdata, bool replaces=false) {
+            queue(IORING_OP_WRITE, fd, buf, len, off, userdata, -1, replaces);
+        }
+
+        void nop(uint64_t userdata) {
+            queue(IORING_OP_NOP, -1, NULL, 0, 0, userdata, -1, true);
+        }
+
+        void submit() {
+            sqlock.lock();
+            flush();
+            sqlock.unlock();
+        }
+
+        /* Blocks until a request completes; res is its byte count or -errno. */
+        void wait(uint64_t & userdata, int & res) {
+            while (true) {
+                unsigned head = *cq_head;
+                if (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                    struct io_uring_cqe * cqe = &cqes[head & *cq_mask];
+                    userdata = cqe->user_data;
+                    res = cqe->res;
+                    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+                    __sync_sub_and_fetch(&inflight, 1);
+                    return;
+                }
+                if (enter(ringfd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                    logstream(LOG_FATAL) << "io_uring wait failed: " << strerror(errno) << std::endl;
+                    assert(false);
+                }
+            }
+        }
+#else
+    public:
+        bool init(unsigned depth) {
+            errno = ENOSYS;
+            return false;
+        }
+        unsigned depth() { return 0; }
+        bool register_buffers(std::vector<struct iovec> & iov) { return false; }
+        void read(int fd, void * buf, unsigned len, uint64_t off, uint64_t userdata, bool replaces=false) { assert(false); }
+        void read_fixed(int fd, void * buf, unsigned len, uint64_t off, int bufindex, uint64_t userdata, bool replaces=false) { assert(false); }
+        void write(int fd, void * buf, unsigned len, uint64_t off, uint64_t userdata, bool replaces=false) { assert(false); }
+        void nop(uint64_t userdata) { assert(false); }
+        void submit() { assert(false); }
+        void wait(uint64_t & userdata, int & res) { assert(false); }
+#endif
+    };
+
+}
+
+#endif
@@ -52,12 +52,15 @@
 #include "api/graphchi_context.hpp"
 #include "graphchi_types.hpp"
 #include "io/stripedio.hpp"
+#include "io/edatacodec.hpp"
 #include "logger/logger.hpp"
 #include "engine/auxdata/degree_data.hpp"
 #include "metrics/metrics.hpp"
 #include "metrics/reps/basic_reporter.hpp"
 #include "shards/memoryshard.hpp"
 #include "shards/slidingshard.hpp"
+#include "shards/adjencoding.hpp"
+#include "shards/aliastable.hpp"
 #include "output/output.hpp"
 #include "util/ioutil.hpp"
 #include "util/radixSort.hpp"
@@ -110,6 +113,19 @@ namespace graphchi {
         bool stopper() { return src == 0 && dst == 0; }
     };
     
+    /* Weighted edge set aside by finish_shard for the alias tables */
+    struct alias_edge {
+        vid_t src;
+        vid_t dst;
+        float weight;
+        alias_edge() {}
+        alias_edge(vid_t src, vid_t dst, float weight) : src(src), dst(dst), weight(weight) {}
+    };
+    
+    static VARIABLE_IS_NOT_USED bool alias_edge_less(const alias_edge &a, const alias_edge &b) {
+        return a.src < b.src || (a.src == b.src && a.dst < b.dst);
+    }
+    
     template <typename EdgeDataType>
     bool edge_t_src_less(const edge_with_value<EdgeDataType> &a, const edge_with_value<EdgeDataType> &b) {
         if (a.src == b.src) {
@@ -311,6 +327,10 @@ namespace graphchi {
         DuplicateEdgeFilter<EdgeDataType> * duplicate_edge_filter;
         
         bool no_edgevalues;
+        bool alias_tables;
+        adj_encoding_t adjencoding;
+        block_codec_t edatacodec;
+        adj_encoding curencoding;
 #ifdef DYNAMICEDATA
         edge_t last_added_edge;
 #endif
@@ -339,6 +359,10 @@ namespace graphchi {
             while (compressed_block_size % sizeof(FinalEdgeDataType) != 0) compressed_block_size++;
             edges_per_block = compressed_block_size / sizeof(FinalEdgeDataType);
             duplicate_edge_filter = NULL;
+            adjencoding = adj_encoding_option();
+            edatacodec = parse_block_codec(get_option_string("edata.codec", "zlib"));
+            /* With weighted 1 the edge values are weights, and walks draw out-edges by weight */
+            alias_tables = get_option_int("weighted", 0) == 1;
         }
         
         
@@ -479,6 +503,26 @@ namespace graphchi {
             bufptr += sizeof(T);
         }
         
+        /**
+         * Writes the next neighbor id of a vertex in the adjacency encoding
+         * of the shard. prev is the previous id of the vertex, or the base
+         * of the shard before the first one.
+         */
+        void bwrite_nbr(int f, char * buf, char * &bufptr, vid_t dst, vid_t &prev) {
+            if (curencoding.type == ADJ_RAW) {
+                bwrite(f, buf, bufptr, dst);
+                return;
+            }
+            if (dst < prev) {
+                logstream(LOG_FATAL) << "Neighbor " << dst << " out of order after " << prev << ", cannot delta-encode the shard." << std::endl;
+                assert(false);
+            }
+            uint8_t bytes[5];
+            int n = varint_encode(dst - prev, bytes);
+            for(int k=0; k < n; k++) bwrite<uint8_t>(f, buf, bufptr, bytes[k]);
+            prev = dst;
+        }
+        
         int blockid;
         
         template <typename T>
@@ -489,7 +533,7 @@ namespace graphchi {
             
             std::string block_filename = filename_shard_edata_block(shard_filename, blockid, compressed_block_size);
             int f = open(block_filename.c_str(), O_RDWR | O_CREAT, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
-            write_compressed(f, buf, len);
+            write_compressed(f, buf, len, edatacodec);
             close(f);
             
             m.stop_time("edata_flush");
@@ -615,6 +659,12 @@ namespace graphchi {
             return ss.str();
         }
         
+        std::string alias_edges_filename(int shard) {
+            std::stringstream ss;
+            ss << basefilename << ".aliasedges." << shard;
+            return ss.str();
+        }
+        
         
         int lastpart;
         degree * degrees;
@@ -630,6 +680,10 @@ namespace graphchi {
             std::string edfname = filename_shard_edata<FinalEdgeDataType>(basefilename, shard, nshards);
             std::string edblockdirname = dirname_shard_edata_block(edfname, compressed_block_size);
             
+            /* Neighbor ids of a varint shard are deltas from the start of its interval */
+            curencoding = adj_encoding(adjencoding, intervals[shard].first);
+            write_adj_encoding(fname, curencoding);
+            
             /* Make the block directory */
             if (!no_edgevalues)
                 mkdir(edblockdirname.c_str(), 0777);
@@ -692,6 +746,7 @@ namespace graphchi {
             char * ebufptr = ebuf;
             
             vid_t curvid=0;
+            std::vector<alias_edge> aliasedges;
 #ifdef DYNAMICEDATA
             vid_t lastdst = 0xffffffff;
             int jumpover = 0;
@@ -719,6 +774,7 @@ namespace graphchi {
 #endif
                 
                 if (!edge.stopper()) {
+                    if (alias_tables) aliasedges.push_back(alias_edge(edge.src, edge.dst, alias_weight(edge.value)));
 #ifndef DYNAMICEDATA
                     bwrite_edata<FinalEdgeDataType>(ebuf, ebufptr, FinalEdgeDataType(edge.value), tot_edatabytes, edfname, edgecounter);
 #else
@@ -787,16 +843,18 @@ namespace graphchi {
                     
                   
                         
+                    vid_t prevdst = curencoding.base;
                     for(size_t j=istart; j < i; j++) {
-                        bwrite(f, buf, bufptr,  shovelbuf[j].dst);
+                        bwrite_nbr(f, buf, bufptr, shovelbuf[j].dst, prevdst);
                     }
 #else
                     
                     // Special dealing with dynamic edata because some edges can be present multiple
                     // times in the shovel.
+                    vid_t prevdst = curencoding.base;
                     for(size_t j=istart; j < i; j++) {
                         if (j == istart || shovelbuf[j - 1].dst != shovelbuf[j].dst) {
-                            bwrite(f, buf, bufptr,  shovelbuf[j].dst);
+                            bwrite_nbr(f, buf, bufptr, shovelbuf[j].dst, prevdst);
                         }
                     }
 #endif
@@ -846,6 +904,18 @@ namespace graphchi {
             }
             free(ebuf);
             
+            /* Weighted edges of the shard, sorted by source, for write_alias_tables */
+            if (alias_tables) {
+                std::string aliasfname = alias_edges_filename(shard);
+                int af = open(aliasfname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+                if (af < 0) {
+                    logstream(LOG_FATAL) << "Could not open " << aliasfname << " error: " << strerror(errno) << std::endl;
+                }
+                assert(af >= 0);
+                if (!aliasedges.empty()) writea(af, &aliasedges[0], aliasedges.size() * sizeof(alias_edge));
+                close(af);
+            }
+            
             m.stop_time("shard_final");
         }
         
@@ -939,6 +1009,7 @@ namespace graphchi {
          */
         virtual void write_shards() {
             
+            write_edata_codec(basefilename, edatacodec);
             size_t membudget_mb = (size_t) get_option_int("membudget_mb", 1024);
             
             // Check if we have enough memory to keep track
@@ -987,6 +1058,10 @@ namespace graphchi {
                 delete (shovel_merge_source<EdgeDataType> *)sources[i];
             }
             
+            if (alias_tables) {
+                write_alias_tables();
+            }
+            
             
             if (!count_degrees_inmem) {
 #ifndef DYNAMICEDATA
@@ -1010,6 +1085,69 @@ namespace graphchi {
         }
         
         
+        /**
+         * Writes the alias tables of every interval from the weighted edges
+         * that finish_shard set aside. These are sorted by source in every
+         * shard, so the out-edges of an interval are read in one pass over
+         * all shards and the interval is the only part held in memory.
+         */
+        void write_alias_tables() {
+            m.start_time("alias_tables");
+            int nparts = (int)intervals.size();
+            logstream(LOG_INFO) << "Writing alias tables of " << nparts << " intervals." << std::endl;
+            std::vector<FILE *> parts(nparts);
+            std::vector<alias_edge> next(nparts);
+            std::vector<bool> more(nparts);
+            for(int q=0; q < nparts; q++) {
+                parts[q] = fopen(alias_edges_filename(q).c_str(), "r");
+                if (parts[q] == NULL) {
+                    logstream(LOG_FATAL) << "Could not open " << alias_edges_filename(q) << " error: " << strerror(errno) << std::endl;
+                }
+                assert(parts[q] != NULL);
+                more[q] = fread(&next[q], sizeof(alias_edge), 1, parts[q]) == 1;
+            }
+            for(int p=0; p < nparts; p++) {
+                vid_t st = intervals[p].first, en = intervals[p].second;
+                std::vector<alias_edge> edges;
+                for(int q=0; q < nparts; q++) {
+                    while (more[q] && next[q].src <= en) {
+                        edges.push_back(next[q]);
+                        more[q] = fread(&next[q], sizeof(alias_edge), 1, parts[q]) == 1;
+                    }
+                }
+                /* The tables follow the out-edges of a vertex ordered by target */
+                std::stable_sort(edges.begin(), edges.end(), alias_edge_less);
+                
+                std::vector<uint64_t> offsets(en - st + 2, 0);
+                std::vector<float> weights(edges.size());
+                for(size_t i=0; i < edges.size(); i++) {
+                    offsets[edges[i].src - st + 1]++;
+                    weights[i] = edges[i].weight;
+                }
+                for(size_t i=1; i < offsets.size(); i++) offsets[i] += offsets[i - 1];
+                std::vector<alias_entry> entries(edges.size());
+                for(size_t i=0; i + 1 < offsets.size(); i++) {
+                    int n = (int)(offsets[i + 1] - offsets[i]);
+                    if (n > 0) build_alias_table(&weights[offsets[i]], n, &entries[offsets[i]]);
+                }
+                
+                std::string fname = filename_shard_alias(basefilename, p, nshards);
+                int f = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+                if (f < 0) {
+                    logstream(LOG_FATAL) << "Could not open " << fname << " error: " << strerror(errno) << std::endl;
+                }
+                assert(f >= 0);
+                writea(f, &offsets[0], offsets.size() * sizeof(uint64_t));
+                if (!entries.empty()) writea(f, &entries[0], entries.size() * sizeof(alias_entry));
+                close(f);
+            }
+            for(int q=0; q < nparts; q++) {
+                fclose(parts[q]);
+                remove(alias_edges_filename(q).c_str());
+            }
+            m.stop_time("alias_tables");
+        }
+        
         typedef char dummy_t;
         
         typedef sliding_shard<int, dummy_t> slidingshard_t;
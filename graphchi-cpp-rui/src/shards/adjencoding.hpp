@@ -0,0 +1,110 @@
+#ifndef DEF_GRAPHCHI_ADJENCODING
+#define DEF_GRAPHCHI_ADJENCODING
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+
+#include "api/chifilenames.hpp"
+#include "logger/logger.hpp"
+#include "util/cmdopts.hpp"
+#include "graphchi_types.hpp"
+
+namespace graphchi {
+
+    /**
+     * Encodings of the neighbor ids in a shard adjacency file. The vertex
+     * records (edge counts and runs of vertices without edges) are the
+     * same in both; only the ids after a count differ.
+     *
+     * ADJ_RAW: every id as a 32-bit vid_t.
+     * ADJ_VARINT: the ids of a vertex are sorted, so the first is stored as
+     * its distance from the base of the shard and the others as the
+     * distance from their predecessor, each as a little-endian base-128
+     * varint (7 bits per byte, high bit set on all but the last byte).
+     *
+     * The encoding and the base are kept in a small side file next to the
+     * adjacency file, which is missing for raw shards. The adjacency index
+     * records byte offsets at vertex boundaries, where the deltas restart,
+     * so it serves as the skip index of both encodings.
+     */
+    enum adj_encoding_t { ADJ_RAW = 0, ADJ_VARINT = 1 };
+
+    struct adj_encoding {
+        adj_encoding_t type;
+        vid_t base;
+        adj_encoding() : type(ADJ_RAW), base(0) {}
+        adj_encoding(adj_encoding_t type, vid_t base) : type(type), base(base) {}
+    };
+
+    static VARIABLE_IS_NOT_USED adj_encoding read_adj_encoding(std::string adjfilename) {
+        adj_encoding enc;
+        FILE * f = fopen(filename_shard_adj_encoding(adjfilename).c_str(), "r");
+        if (f == NULL) return enc;
+        char name[64];
+        unsigned int base;
+        if (fscanf(f, "%63s %u", name, &base) != 2 || std::string(name) != "varint") {
+            logstream(LOG_FATAL) << "Unknown adjacency encoding in " << filename_shard_adj_encoding(adjfilename) << std::endl;
+            assert(false);
+        }
+        fclose(f);
+        return adj_encoding(ADJ_VARINT, (vid_t)base);
+    }
+
+    static VARIABLE_IS_NOT_USED void write_adj_encoding(std::string adjfilename, adj_encoding enc) {
+        std::string fname = filename_shard_adj_encoding(adjfilename);
+        if (enc.type == ADJ_RAW) {
+            remove(fname.c_str());
+            return;
+        }
+        FILE * f = fopen(fname.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_FATAL) << "Could not write " << fname << " error: " << strerror(errno) << std::endl;
+        }
+        assert(f != NULL);
+        fprintf(f, "varint %u\n", (unsigned int)enc.base);
+        fclose(f);
+    }
+
+    /* Encoding selected with the option shard.adjencoding: raw or varint. */
+    static VARIABLE_IS_NOT_USED adj_encoding_t adj_encoding_option() {
+        std::string name = get_option_string("shard.adjencoding", "raw");
+        if (name == "raw") return ADJ_RAW;
+        if (name == "varint") return ADJ_VARINT;
+        logstream(LOG_FATAL) << "Unknown shard.adjencoding " << name << ", expected raw or varint." << std::endl;
+        assert(false);
+        return ADJ_RAW;
+    }
+
+    /* Writes x to out, returns the number of bytes (1 to 5). */
+    static inline int varint_encode(uint32_t x, uint8_t * out) {
+        int n = 0;
+        while (x >= 0x80) {
+            out[n++] = (uint8_t)(x | 0x80);
+            x >>= 7;
+        }
+        out[n++] = (uint8_t)x;
+        return n;
+    }
+
+    static inline uint32_t varint_decode(uint8_t * &ptr) {
+        uint32_t x = *ptr & 0x7f;
+        int shift = 7;
+        while (*ptr++ & 0x80) {
+            x |= (uint32_t)(*ptr & 0x7f) << shift;
+            shift += 7;
+        }
+        return x;
+    }
+
+    /* Moves ptr past n varints. */
+    static inline void varint_skip(uint8_t * &ptr, int n) {
+        while (n > 0) {
+            if (!(*ptr++ & 0x80)) n--;
+        }
+    }
+}
+
+#endif
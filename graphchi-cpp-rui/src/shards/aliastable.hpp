@@ -0,0 +1,158 @@
+#ifndef DEF_GRAPHCHI_ALIASTABLE
+#define DEF_GRAPHCHI_ALIASTABLE
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "api/chifilenames.hpp"
+#include "logger/logger.hpp"
+#include "util/ioutil.hpp"
+#include "graphchi_types.hpp"
+
+namespace graphchi {
+
+    /**
+     * Alias tables for drawing an out-edge by weight in O(1). The table of
+     * a vertex has one entry per out-edge, in the order of the targets:
+     * out-edge j is kept with probability prob, otherwise out-edge alias
+     * is taken.
+     *
+     * The sharder writes one file per interval (filename_shard_alias) with
+     * the nverts + 1 offsets (uint64_t) of the tables of its vertices,
+     * followed by the entries of all tables. Only weighted graphs have
+     * them, see sharder::write_alias_tables.
+     */
+    struct alias_entry {
+        float prob;
+        uint32_t alias;
+    };
+
+    /* Weight of an edge with value x; 1 for edge types that are not numbers */
+    template <typename T>
+    static inline float alias_weight(const T &) { return 1.0f; }
+    static inline float alias_weight(int x) { return (float)x; }
+    static inline float alias_weight(unsigned int x) { return (float)x; }
+    static inline float alias_weight(long x) { return (float)x; }
+    static inline float alias_weight(float x) { return x; }
+    static inline float alias_weight(double x) { return (float)x; }
+
+    /**
+     * Builds the alias table of n out-edges from their weights in O(n)
+     * (Vose's method). Out-edges of a vertex without positive weights are
+     * drawn uniformly.
+     */
+    static VARIABLE_IS_NOT_USED void build_alias_table(const float * weights, int n, alias_entry * table) {
+        double sum = 0;
+        for(int j=0; j < n; j++) sum += std::max(weights[j], 0.0f);
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        for(int j=0; j < n; j++) {
+            scaled[j] = sum > 0 ? std::max(weights[j], 0.0f) * n / sum : 1.0;
+            if (scaled[j] < 1.0) small.push_back(j);
+            else large.push_back(j);
+        }
+        while (!small.empty() && !large.empty()) {
+            int l = small.back(), g = large.back();
+            small.pop_back();
+            table[l].prob = (float)scaled[l];
+            table[l].alias = g;
+            scaled[g] -= 1.0 - scaled[l];
+            if (scaled[g] < 1.0) {
+                large.pop_back();
+                small.push_back(g);
+            }
+        }
+        /* What is left has probability 1 up to rounding */
+        for(int i=0; i < (int)large.size(); i++) {
+            table[large[i]].prob = 1.0f;
+            table[large[i]].alias = large[i];
+        }
+        for(int i=0; i < (int)small.size(); i++) {
+            table[small[i]].prob = 1.0f;
+            table[small[i]].alias = small[i];
+        }
+    }
+
+    /**
+     * The alias tables of a window of vertices, which may span several
+     * intervals. The engine loads them together with the edges of the
+     * window.
+     */
+    class alias_table {
+
+        std::string base_filename;
+        int nshards;
+        std::vector<std::pair<vid_t, vid_t> > intervals;
+
+        /* Loaded window: the tables of vertex st + i are entries offsets[i] to offsets[i + 1] */
+        vid_t st, en;
+        std::vector<uint64_t> offsets;
+        std::vector<alias_entry> entries;
+
+    public:
+        typedef alias_entry entry_t;
+
+        alias_table(std::string base_filename, std::vector<std::pair<vid_t, vid_t> > intervals) :
+            base_filename(base_filename), nshards((int)intervals.size()), intervals(intervals), st(0), en(0) {
+            offsets.assign(1, 0);
+        }
+
+        /* Whether the graph was sharded with alias tables */
+        static bool exists(std::string base_filename, int nshards) {
+            return file_exists(filename_shard_alias(base_filename, 0, nshards));
+        }
+
+        /* Loads the tables of the vertices _st to _en, replacing the loaded ones. */
+        void load(vid_t _st, vid_t _en) {
+            st = _st;
+            en = _en;
+            offsets.assign(1, 0);
+            entries.clear();
+            for(int p=0; p < nshards; p++) {
+                if (intervals[p].second < st || intervals[p].first > en) continue;
+                vid_t a = std::max(st, intervals[p].first);
+                vid_t b = std::min(en, intervals[p].second);
+                std::string fname = filename_shard_alias(base_filename, p, nshards);
+                int f = open(fname.c_str(), O_RDONLY);
+                if (f < 0) {
+                    logstream(LOG_FATAL) << "Could not open alias tables " << fname << " error: " << strerror(errno) << std::endl;
+                }
+                assert(f >= 0);
+                std::vector<uint64_t> offs(b - a + 2);
+                preada(f, &offs[0], offs.size() * sizeof(uint64_t), (a - intervals[p].first) * sizeof(uint64_t));
+                size_t tables = (intervals[p].second - intervals[p].first + 2) * sizeof(uint64_t);
+                size_t n0 = entries.size();
+                entries.resize(n0 + offs.back() - offs[0]);
+                if (offs.back() > offs[0]) {
+                    preada(f, &entries[n0], (offs.back() - offs[0]) * sizeof(alias_entry), tables + offs[0] * sizeof(alias_entry));
+                }
+                for(size_t i=1; i < offs.size(); i++) offsets.push_back(n0 + offs[i] - offs[0]);
+                close(f);
+            }
+            assert(offsets.size() == size_t(en - st + 2));
+        }
+
+        /* Number of entries in the table of v, which has to be loaded */
+        int degree(vid_t v) const {
+            return (int)(offsets[v - st + 1] - offsets[v - st]);
+        }
+
+        /* Table of v, which has to be loaded; NULL for a sink */
+        const alias_entry * row(vid_t v) const {
+            return degree(v) > 0 ? &entries[offsets[v - st]] : NULL;
+        }
+
+        /* Memory taken by the tables of nvertices vertices and nedges out-edges */
+        static size_t bytes(size_t nvertices, size_t nedges) {
+            return nvertices * sizeof(uint64_t) + nedges * sizeof(alias_entry);
+        }
+    };
+}
+
+#endif
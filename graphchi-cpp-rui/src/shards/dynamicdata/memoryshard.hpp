@@ -43,6 +43,7 @@
 #include "api/graph_objects.hpp"
 #include "metrics/metrics.hpp"
 #include "io/stripedio.hpp"
+#include "shards/adjencoding.hpp"
 #include "graphchi_types.hpp"
 #include "shards/dynamicdata/dynamicblock.hpp"
 
@@ -80,6 +81,7 @@ namespace graphchi {
         bool is_loaded;
         size_t blocksize;
         metrics &m;
+        adj_encoding encoding;
 
         bool disable_async_writes;
 
@@ -280,6 +282,7 @@ namespace graphchi {
             
             adj_session = iomgr->open_session(filename_adj, true);
             iomgr->managed_malloc(adj_session, &adjdata, adjfilesize, 0);
+            encoding = read_adj_encoding(filename_adj);
             
             size_t bufsize = 16 * 1204 * 1024;
             int n = (int) (adjfilesize / bufsize + 1);
@@ -363,11 +366,16 @@ namespace graphchi {
                     if (!vertex->scheduled) vertex = NULL;
                 }
                 bool any_edges = false;
+                vid_t target = encoding.base;
                 while(--n>=0) {
                     int blockid = (int) (edgeptr / blocksize);
                                         
-                    vid_t target = *((vid_t*) ptr);
-                    ptr += sizeof(vid_t);
+                    if (encoding.type == ADJ_VARINT) {
+                        target += varint_decode(ptr);
+                    } else {
+                        target = *((vid_t*) ptr);
+                        ptr += sizeof(vid_t);
+                    }
                     if (vertex != NULL && outedges)
                     {
                         check_block_initialized(blockid);
@@ -391,7 +399,8 @@ namespace graphchi {
                         } else { // Note, we cannot skip if there can be "special edges". FIXME so dirty.
                             // This vertex has no edges any more for this window, bail out
                             if (vertex == NULL) {
-                                ptr += sizeof(vid_t) * n;
+                                if (encoding.type == ADJ_VARINT) varint_skip(ptr, n);
+                                else ptr += sizeof(vid_t) * n;
                                 edgeptr += (n + 1) * sizeof(int);
                                 break;
                             }
@@ -46,6 +46,7 @@
 #include "api/graph_objects.hpp"
 #include "metrics/metrics.hpp"
 #include "io/stripedio.hpp"
+#include "shards/adjencoding.hpp"
 #include "graphchi_types.hpp"
 
 
@@ -87,6 +88,7 @@ namespace graphchi {
         size_t blocksize;
         metrics &m;
         std::vector<shard_index> index;
+        adj_encoding encoding;
         
     public:
         bool only_adjacency;
@@ -121,6 +123,8 @@ namespace graphchi {
                 if (edgedata[i] != NULL && block_edatasessions[i] != CACHED_SESSION_ID) {
                     iomgr->managed_release(block_edatasessions[i], &edgedata[i]);
                     iomgr->close_session(block_edatasessions[i]);
+                } else if (edgedata[i] != NULL) {
+                    iomgr->get_block_cache().release_cached(edgedata[i], false);
                 }
             }
             if (adj_session >= 0) {
@@ -175,12 +179,16 @@ namespace graphchi {
                                 iomgr->close_session(block_edatasessions[i]);
                                 block_edatasessions[i] = CACHED_SESSION_ID;
                             }
+                        } else {
+                            iomgr->get_block_cache().release_cached(edgedata[i], true);
                         }
                         edgedata[i] = NULL;
                         
                     } else {
                         if (block_edatasessions[i] != CACHED_SESSION_ID) {
                             iomgr->managed_pwritea_async(block_edatasessions[i], &edgedata[i], blocksizes[i], 0, true, true);
+                        } else {
+                            iomgr->get_block_cache().release_cached(edgedata[i], true);
                         }
                         edgedata[i] = NULL;
                     }
@@ -196,10 +204,11 @@ namespace graphchi {
                 int endblock = (int) (last / blocksize);
 #pragma omp parallel for
                 for(int i=0; i < nblocks; i++) {
+                    bool modified = (i >= startblock && i <= endblock);
                     if (block_edatasessions[i] != CACHED_SESSION_ID) {
                         if (false == iomgr->get_block_cache().consider_caching(
-                                                                               iomgr->get_session_filename(block_edatasessions[i]), edgedata[i], blocksizes[i], true)) {
-                            if (i >= startblock && i <= endblock) {
+                                                                               iomgr->get_session_filename(block_edatasessions[i]), edgedata[i], blocksizes[i], true, modified)) {
+                            if (modified) {
                                 iomgr->managed_pwritea_now(block_edatasessions[i], &edgedata[i], blocksizes[i], 0);
                             }
                             iomgr->managed_release(block_edatasessions[i], &edgedata[i]);
@@ -208,13 +217,23 @@ namespace graphchi {
                             iomgr->close_session(block_edatasessions[i]);
                             block_edatasessions[i] = CACHED_SESSION_ID;
                         }
+                    } else {
+                        iomgr->get_block_cache().release_cached(edgedata[i], modified);
                     }
                     edgedata[i] = NULL;
                 }
             } else {
+                /* Nothing was modified, so the blocks can be cached clean */
                 for(int i=0; i < nblocks; i++) {
                     if (block_edatasessions[i] != CACHED_SESSION_ID) {
+                        if (edgedata[i] != NULL && iomgr->get_block_cache().consider_caching(
+                                                                               iomgr->get_session_filename(block_edatasessions[i]), edgedata[i], blocksizes[i], true, false)) {
+                            edgedata[i] = NULL;
+                        }
                         iomgr->close_session(block_edatasessions[i]);
+                    } else {
+                        iomgr->get_block_cache().release_cached(edgedata[i], false);
+                        edgedata[i] = NULL;
                     }
                 }
             }
@@ -377,6 +396,7 @@ namespace graphchi {
             
             // Get index
             index = load_index();
+            encoding = read_adj_encoding(filename_adj);
         }
         
         
@@ -472,11 +492,16 @@ namespace graphchi {
                         if (!vertex->scheduled) vertex = NULL;
                     }
                     bool any_edges = false;
+                    vid_t target = encoding.base;
                     while(--n>=0) {
                         int blockid = (int) (edgeptr / blocksize);
                        
-                        vid_t target = *((vid_t*) ptr);
-                        ptr += sizeof(vid_t);
+                        if (encoding.type == ADJ_VARINT) {
+                            target += varint_decode(ptr);
+                        } else {
+                            target = *((vid_t*) ptr);
+                            ptr += sizeof(vid_t);
+                        }
                         if (vertex != NULL && outedges)
                         {
                             char * eptr = (only_adjacency ? NULL  : &(edgedata[blockid][edgeptr % blocksize]));
@@ -499,7 +524,8 @@ namespace graphchi {
                             } else { // Note, we cannot skip if there can be "special edges". FIXME so dirty.
                                 // This vertex has no edges any more for this window, bail out
                                 if (vertex == NULL) {
-                                    ptr += sizeof(vid_t) * n;
+                                    if (encoding.type == ADJ_VARINT) varint_skip(ptr, n);
+                                    else ptr += sizeof(vid_t) * n;
                                     edgeptr += (n + 1) * sizeof(ET);
                                     break;
                                 }
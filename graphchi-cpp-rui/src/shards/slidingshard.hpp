@@ -48,6 +48,7 @@
 #include "metrics/metrics.hpp"
 #include "logger/logger.hpp"
 #include "io/stripedio.hpp"
+#include "shards/adjencoding.hpp"
 #include "graphchi_types.hpp"
 
 
@@ -86,6 +87,9 @@ namespace graphchi {
                         iomgr->managed_pwritea_async(writedesc, &data, end-offset, offset, true);
                     }
                 }
+            } else if (data != NULL) {
+                iomgr->get_block_cache().release_cached(data, active);
+                data = NULL;
             }
         }
         
@@ -100,11 +104,15 @@ namespace graphchi {
                             iomgr->managed_pwritea_now(writedesc, &data, end - offset, 0); /* Need to write whole block in the compressed regime */
                         } else {
                             readdesc = writedesc = CACHED_SESSION_ID; // Cached - so don't release
+                            data = NULL;
                         }
                     } else {
                         iomgr->managed_pwritea_now(writedesc, &data, len, offset);
                     }
                 }
+            } else if (data != NULL) {
+                iomgr->get_block_cache().release_cached(data, active);
+                data = NULL;
             }
         }
         void read_async(stripedio * iomgr) {
@@ -137,6 +145,8 @@ namespace graphchi {
                     iomgr->managed_release(readdesc, &data);
                     
                 }
+            } else if (data != NULL) {
+                iomgr->get_block_cache().release_cached(data, false);
             }
             data = NULL;
             
@@ -178,6 +188,7 @@ namespace graphchi {
         bool disable_writes;
         bool async_edata_loading;
         bool disable_async_writes;
+        adj_encoding encoding;
         // bool need_read_outedges; // Disabled - does not work with compressed data: whole block needs to be read.
         
         
@@ -217,6 +228,11 @@ namespace graphchi {
             }
             
             adjfile_session = iomgr->open_session(filename_adj, true);
+            encoding = read_adj_encoding(filename_adj);
+            if (encoding.type != ADJ_RAW && sizeof(ET) != sizeof(ETspecial)) {
+                logstream(LOG_FATAL) << "Special edges need raw shards, " << filename_adj << " is delta-encoded." << std::endl;
+                assert(false);
+            }
             save_offset();
             
             async_edata_loading = !svertex_t().computational_edges();
@@ -374,6 +390,42 @@ namespace graphchi {
             return resptr;
         }
         
+        /**
+         * Reads the next neighbor id of a vertex; prev is the previous one,
+         * or the base of the shard before the first. A varint that lies in
+         * the current block is decoded in place.
+         */
+        inline vid_t read_nbr(vid_t &prev) {
+            if (encoding.type == ADJ_RAW) return read_val<vid_t>();
+            if (curadjblock != NULL && adjoffset + 5 <= curadjblock->end) {
+                uint8_t * p = curadjblock->ptr;
+                prev += varint_decode(curadjblock->ptr);
+                adjoffset += curadjblock->ptr - p;
+                return prev;
+            }
+            uint32_t x = 0;
+            uint8_t b;
+            int shift = 0;
+            do {
+                b = read_val<uint8_t>();
+                x |= (uint32_t)(b & 0x7f) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            prev += x;
+            return prev;
+        }
+        
+        /* Skips the n neighbor ids of a vertex and their edge values. */
+        inline void skip_nbrs(int n) {
+            if (encoding.type == ADJ_RAW) {
+                skip(n, sizeof(vid_t));
+                return;
+            }
+            vid_t prev = 0;
+            for(int j=0; j < n; j++) read_nbr(prev);
+            skip(n, 0);
+        }
+        
         inline void skip(int n, int sz) {
             size_t tot = n * sz;
             adjoffset += tot;
@@ -391,6 +443,8 @@ namespace graphchi {
         void read_next_vertices(int nvecs, vid_t start,  std::vector<svertex_t> & prealloc, bool record_index=false, bool disable_writes=false)  {
             metrics_entry me = m.start_time();
             
+            if (start < curvid)
+                rewind_to(start, disable_writes);
             if (!record_index)
                 move_close_to(start);
             
@@ -433,15 +487,15 @@ namespace graphchi {
                 
                 if (i<0) {
                     // Just skipping
-                    skip(n, sizeof(vid_t));
+                    skip_nbrs(n);
                 } else {
                     svertex_t& vertex = prealloc[i];
                     
                     if (vertex.scheduled) {
-                        
+                        vid_t prev = encoding.base;
                         while(--n >= 0) {
                             bool special_edge = false;
-                            vid_t target = (sizeof(ET) == sizeof(ETspecial) ? read_val<vid_t>() : translate_edge(read_val<vid_t>(), special_edge));
+                            vid_t target = (sizeof(ET) == sizeof(ETspecial) ? read_nbr(prev) : translate_edge(read_val<vid_t>(), special_edge));
                             ET * evalue = (special_edge ? (ET*)read_edgeptr<ETspecial>(): read_edgeptr<ET>());
                             
                             if (!only_adjacency) {
@@ -466,7 +520,7 @@ namespace graphchi {
                         
                     } else {
                         // This vertex was not scheduled, so we can just skip its edges.
-                        skip(n, sizeof(vid_t));
+                        skip_nbrs(n);
                     }
                 }
                 curvid++;
@@ -518,6 +572,21 @@ namespace graphchi {
             }
         }
         
+        /**
+         * Moves back to the closest recorded position at or before v.
+         * Walks visit the intervals in any order, so a window can start
+         * before the current position, whose vertices would otherwise get
+         * no out-edges from this shard.
+         */
+        void rewind_to(vid_t v, bool disable_writes=false) {
+            release_prior_to_offset(true, disable_writes);
+            std::map<int,indexentry>::iterator lowerbd_iter = sparse_index.lower_bound(-((int)v));
+            assert(lowerbd_iter != sparse_index.end());
+            logstream(LOG_DEBUG) << "Sliding shard, start: " << range_st << " rewound to: " << -lowerbd_iter->first
+                << ", asked for : " << v << " was in: curvid= " << curvid << std::endl;
+            set_offset(lowerbd_iter->second.adjoffset, (vid_t) -lowerbd_iter->first, lowerbd_iter->second.edataoffset);
+        }
+        
         /**
          * Release blocks that come prior to the current offset/
          */
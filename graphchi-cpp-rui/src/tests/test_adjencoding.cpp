@@ -0,0 +1,120 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Round trip of the varint adjacency encoding: single values at the
+ * boundaries of every byte length, neighbor lists stored as deltas from
+ * the shard base and from their predecessor, skipping over a list, and
+ * the side file that records the encoding.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+#include "logger/logger.hpp"
+#include "shards/adjencoding.hpp"
+
+using namespace graphchi;
+
+/* Encodes the sorted ids like the sharder: the first from base, then deltas */
+static size_t encode_list(const std::vector<vid_t> &ids, vid_t base, std::vector<uint8_t> &out) {
+    size_t start = out.size();
+    vid_t prev = base;
+    for(size_t i=0; i < ids.size(); i++) {
+        uint8_t bytes[5];
+        int n = varint_encode(ids[i] - prev, bytes);
+        out.insert(out.end(), bytes, bytes + n);
+        prev = ids[i];
+    }
+    return out.size() - start;
+}
+
+static void check_list(std::vector<vid_t> ids, vid_t base) {
+    std::sort(ids.begin(), ids.end());
+    std::vector<uint8_t> buf;
+    encode_list(ids, base, buf);
+    buf.push_back(0x55); // Sentinel after the list
+
+    uint8_t * ptr = &buf[0];
+    vid_t prev = base;
+    for(size_t i=0; i < ids.size(); i++) {
+        prev += varint_decode(ptr);
+        assert(prev == ids[i]);
+    }
+    assert(*ptr == 0x55);
+
+    ptr = &buf[0];
+    varint_skip(ptr, (int)ids.size());
+    assert(*ptr == 0x55);
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    
+    /* Boundaries of every byte length: 1 byte up to 2^7 - 1, ..., 5 bytes for the rest */
+    uint32_t extremes[] = { 0, 1, 127, 128, 16383, 16384, 2097151, 2097152,
+        268435455, 268435456, 0x7fffffffu, 0x80000000u, 0xfffffffeu, 0xffffffffu };
+    int lengths[] = { 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5 };
+    for(int i=0; i < (int)(sizeof(extremes) / sizeof(extremes[0])); i++) {
+        uint8_t buf[8];
+        memset(buf, 0xff, sizeof(buf));
+        int n = varint_encode(extremes[i], buf);
+        assert(n == lengths[i]);
+        for(int j=0; j < n - 1; j++) assert(buf[j] & 0x80);
+        assert(!(buf[n - 1] & 0x80));
+        uint8_t * ptr = buf;
+        assert(varint_decode(ptr) == extremes[i]);
+        assert(ptr == buf + n);
+    }
+    logstream(LOG_INFO) << "Varint extremes OK." << std::endl;
+
+    /* Neighbor lists: empty, dense, equal ids, the first at the base and at the top of the id range */
+    check_list(std::vector<vid_t>(), 0);
+    std::vector<vid_t> dense;
+    for(vid_t v=1000; v < 1300; v++) dense.push_back(v);
+    check_list(dense, 1000);
+    check_list(std::vector<vid_t>(5, 77), 3);
+    std::vector<vid_t> spread;
+    spread.push_back(0);
+    spread.push_back(127);
+    spread.push_back(128);
+    spread.push_back(0x7fffffffu);
+    spread.push_back(0xfffffffeu);
+    check_list(spread, 0);
+    std::vector<vid_t> top;
+    top.push_back(0xfffffff0u);
+    top.push_back(0xfffffffeu);
+    check_list(top, 0xfffffff0u);
+
+    /* Random lists of a shard whose targets start at base */
+    srand(11);
+    for(int t=0; t < 1000; t++) {
+        vid_t base = (vid_t)rand() % 100000;
+        int n = rand() % 64;
+        std::vector<vid_t> ids(n);
+        for(int i=0; i < n; i++) {
+            vid_t span = (t % 2 == 0 ? 1000 : 0x0fffffff);
+            ids[i] = base + (vid_t)rand() % span;
+        }
+        check_list(ids, base);
+    }
+    logstream(LOG_INFO) << "Varint neighbor lists OK." << std::endl;
+
+    /* The side file of the encoding; a missing one means raw */
+    std::string adjfile = "/tmp/graphchi_adjencodingtest.adj";
+    remove(filename_shard_adj_encoding(adjfile).c_str());
+    assert(read_adj_encoding(adjfile).type == ADJ_RAW);
+    write_adj_encoding(adjfile, adj_encoding(ADJ_VARINT, 123456));
+    adj_encoding enc = read_adj_encoding(adjfile);
+    assert(enc.type == ADJ_VARINT && enc.base == 123456);
+    write_adj_encoding(adjfile, adj_encoding());
+    assert(!file_exists(filename_shard_adj_encoding(adjfile)));
+    assert(read_adj_encoding(adjfile).type == ADJ_RAW);
+
+    logstream(LOG_INFO) << "Adjacency encoding test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Round trip of the compressed edge data blocks of every codec that is
+ * built in (make tests/test_block_codecs LZ4=1 ZSTD=1 for all of them).
+ * Checks the header each codec writes, that read_compressed finds the
+ * codec from it, and that a file can be rewritten with another codec.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <vector>
+
+#include "logger/logger.hpp"
+#include "util/ioutil.hpp"
+
+/* Sizes around the 1 MB chunk of the zlib stream */
+static const size_t sizes[] = { 1, 7, 4096, 1024 * 1024, 3 * 1024 * 1024 + 13 };
+
+/* Half of the block repeats, half is noise, so every codec has work to do */
+static void fill(std::vector<unsigned char> &buf, unsigned seed) {
+    srand(seed);
+    for(size_t i=0; i < buf.size(); i++) {
+        buf[i] = (i < buf.size() / 2 ? (unsigned char)(i % 61) : (unsigned char)rand());
+    }
+}
+
+static void check_roundtrip(int f, block_codec_t codec, size_t nbytes) {
+    std::vector<unsigned char> data(nbytes), back(nbytes, 0xab);
+    fill(data, (unsigned)nbytes);
+    size_t written = write_compressed(f, &data[0], nbytes, codec);
+    size_t fsize = lseek(f, 0, SEEK_END);
+    assert(written == fsize);
+
+    unsigned char hdr[BLOCK_CODEC_HEADER];
+    preada(f, hdr, BLOCK_CODEC_HEADER, 0);
+    if (codec == BLOCK_CODEC_ZLIB) {
+        assert(memcmp(hdr, "GCB", 3) != 0);
+    } else {
+        assert(memcmp(hdr, "GCB", 3) == 0);
+        assert(hdr[3] == (unsigned char)codec);
+    }
+    if (codec == BLOCK_CODEC_NONE) assert(fsize == BLOCK_CODEC_HEADER + nbytes);
+    assert(read_block_codec(f, fsize) == codec);
+
+    read_compressed(f, &back[0], nbytes);
+    assert(memcmp(&data[0], &back[0], nbytes) == 0);
+}
+
+int main(int argc, const char ** argv) {
+    char fname[] = "/tmp/graphchi_codectest_XXXXXX";
+    int f = mkstemp(fname);
+    assert(f >= 0);
+
+    block_codec_t codecs[] = { BLOCK_CODEC_ZLIB, BLOCK_CODEC_NONE, BLOCK_CODEC_LZ4, BLOCK_CODEC_ZSTD };
+    int ncodecs = 0;
+    for(int c=0; c < 4; c++) {
+        if (!block_codec_available(codecs[c])) {
+            logstream(LOG_INFO) << "Codec " << block_codec_name(codecs[c]) << " is not built in, skipped." << std::endl;
+            continue;
+        }
+        for(int s=0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+            check_roundtrip(f, codecs[c], sizes[s]);
+        }
+        logstream(LOG_INFO) << "Codec " << block_codec_name(codecs[c]) << " round trip OK." << std::endl;
+        ncodecs++;
+    }
+
+    /* A block rewritten with another codec replaces the old one, longer or shorter */
+    for(int a=0; a < 4; a++) {
+        for(int b=0; b < 4; b++) {
+            if (!block_codec_available(codecs[a]) || !block_codec_available(codecs[b])) continue;
+            check_roundtrip(f, codecs[a], 3 * 1024 * 1024 + 13);
+            check_roundtrip(f, codecs[b], 7);
+            check_roundtrip(f, codecs[a], 4096);
+        }
+    }
+
+    close(f);
+    remove(fname);
+    logstream(LOG_INFO) << "Block codec test passed for " << ncodecs << " codecs." << std::endl;
+    return 0;
+}
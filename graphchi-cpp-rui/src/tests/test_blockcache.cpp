@@ -0,0 +1,145 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Runs the edge data block cache of stripedio with room for only three
+ * of eight blocks, the way memory shards use it: blocks are taken from
+ * the cache or read, changed, and offered back dirty. CLOCK has to write
+ * back every dirty block it evicts, keep pinned blocks, and turn blocks
+ * away when everything is pinned. Afterwards the block files must hold
+ * exactly the changes.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sstream>
+#include <vector>
+
+#include "logger/logger.hpp"
+#include "io/stripedio.hpp"
+#include "metrics/metrics.hpp"
+
+using namespace graphchi;
+
+static const int NBLOCKS = 8;
+static const int BLOCKWORDS = 1024;
+static const size_t BLOCKBYTES = BLOCKWORDS * sizeof(uint32_t);
+
+static std::vector<std::string> names;
+static std::vector<std::vector<uint32_t> > expected;
+
+static void read_block_file(int b, uint32_t * data) {
+    int f = open(names[b].c_str(), O_RDONLY);
+    assert(f >= 0);
+    read_compressed(f, data, BLOCKBYTES);
+    close(f);
+}
+
+/* Adds delta to every word of block b, through the cache like a memory shard */
+static bool change_block(stripedio * iomgr, int b, uint32_t delta) {
+    block_cache &cache = iomgr->get_block_cache();
+    uint32_t * data = (uint32_t *) cache.get_cached(names[b]);
+    bool hit = (data != NULL);
+    if (!hit) {
+        data = (uint32_t *) malloc(BLOCKBYTES);
+        read_block_file(b, data);
+    }
+    for(int k=0; k < BLOCKWORDS; k++) {
+        data[k] += delta;
+        expected[b][k] += delta;
+    }
+    if (hit) {
+        cache.release_cached(data, true);
+    } else if (!cache.consider_caching(names[b], data, BLOCKBYTES, true, true)) {
+        int session = iomgr->open_session(names[b], false, true);
+        iomgr->pwritea_now(session, data, BLOCKBYTES, 0);
+        iomgr->close_session(session);
+        free(data);
+    }
+    return hit;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("test_blockcache");
+    stripedio * iomgr = new stripedio(m);
+    iomgr->set_cache_budget(3 * BLOCKBYTES);
+
+    for(int b=0; b < NBLOCKS; b++) {
+        std::stringstream ss;
+        ss << "/tmp/graphchi_blockcachetest." << getpid() << "." << b;
+        names.push_back(ss.str());
+        expected.push_back(std::vector<uint32_t>(BLOCKWORDS));
+        for(int k=0; k < BLOCKWORDS; k++) expected[b][k] = b * 100000 + k;
+        int f = open(names[b].c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+        assert(f >= 0);
+        write_compressed(f, &expected[b][0], BLOCKBYTES);
+        close(f);
+    }
+
+    /* Sweeps over all blocks evict and write back the dirty ones */
+    for(int round=0; round < 3; round++) {
+        for(int b=0; b < NBLOCKS; b++) change_block(iomgr, b, round + 1);
+    }
+    /* A small working set stays cached */
+    for(int round=0; round < 5; round++) {
+        for(int b=0; b < 3; b++) {
+            bool hit = change_block(iomgr, b, 7);
+            assert(round == 0 || hit);
+        }
+    }
+
+    /* A pinned block survives the others pushing through the cache */
+    block_cache &cache = iomgr->get_block_cache();
+    uint32_t * pinned = (uint32_t *) cache.get_cached(names[0]);
+    assert(pinned != NULL);
+    for(int b=1; b < NBLOCKS; b++) change_block(iomgr, b, 11);
+    for(int k=0; k < BLOCKWORDS; k++) {
+        pinned[k] += 13;
+        expected[0][k] += 13;
+    }
+    assert(cache.get_cached(names[0]) == pinned);
+    cache.release_cached(pinned, false);
+    cache.release_cached(pinned, true);
+
+    /* With every cached block pinned a new block is turned away */
+    std::vector<void *> pins;
+    for(int b=0; b < NBLOCKS; b++) {
+        void * data = cache.get_cached(names[b]);
+        if (data != NULL) pins.push_back(data);
+    }
+    assert(pins.size() == 3);
+    void * extra = malloc(BLOCKBYTES);
+    assert(!cache.consider_caching(names[0] + ".extra", extra, BLOCKBYTES, true, true));
+    free(extra);
+    for(int i=0; i < (int)pins.size(); i++) cache.release_cached(pins[i], false);
+
+    cache.report(m);
+    assert(m.get("blockcache.evictions").value > 0);
+    assert(m.get("blockcache.writebacks").value > 0);
+    assert(m.get("blockcache.rejections").value > 0);
+    logstream(LOG_INFO) << "Evictions: " << m.get("blockcache.evictions").value << ", write-backs: "
+        << m.get("blockcache.writebacks").value << std::endl;
+
+    /* The files have every change once the cached dirty blocks are committed */
+    iomgr->commit_cached_blocks();
+    std::vector<uint32_t> back(BLOCKWORDS);
+    for(int b=0; b < NBLOCKS; b++) {
+        read_block_file(b, &back[0]);
+        for(int k=0; k < BLOCKWORDS; k++) {
+            if (back[k] != expected[b][k]) {
+                logstream(LOG_ERROR) << "Block " << b << " word " << k << ": expected " << expected[b][k] << " but had " << back[k] << std::endl;
+            }
+            assert(back[k] == expected[b][k]);
+        }
+    }
+    delete iomgr;
+    for(int b=0; b < NBLOCKS; b++) remove(names[b].c_str());
+
+    logstream(LOG_INFO) << "Block cache test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ *
+ * Runs the same walks on a small weighted graph out of core and in
+ * memory. Every vertex has to see exactly its out-edges and their values
+ * in both modes, whatever the order the intervals are visited in. The
+ * visit counts written to the vertex data have to be equal. Walks are
+ * repeatable because their steps come from the counter-based RNG and
+ * the alias tables fix the order of the out-edges.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "walks/randomwalk.hpp"
+
+static const int NVERTICES = 300;
+static const int NWALKS = 5000;
+static const int NSTEPS = 8;
+static const unsigned SEED = 17;
+
+/* Out-edges of a vertex as (target, value), sorted by target */
+typedef std::vector<std::pair<vid_t, vid_t> > edgelist_t;
+
+static std::vector<edgelist_t> graph(NVERTICES);
+
+/* Checks the out-edges of every vertex it updates against the graph */
+class EdgeCheckProgram : public RandomWalkProgram {
+public:
+    std::vector<int> seen;
+    mutex lock;
+
+    EdgeCheckProgram() : seen(NVERTICES, 0) {}
+
+    void check(graphchi_vertex<VertexDataType, EdgeDataType> &vertex) {
+        edgelist_t edges;
+        for(int i=0; i < vertex.num_outedges(); i++) {
+            chivector<vid_t> * evector = vertex.outedge(i)->get_vector();
+            assert(evector != NULL && evector->size() == 1);
+            edges.push_back(std::pair<vid_t, vid_t>(vertex.outedge(i)->vertex_id(), evector->get(0)));
+        }
+        if (edges != graph[vertex.id()]) {
+            logstream(LOG_ERROR) << "Vertex " << vertex.id() << " has " << edges.size() << " out-edges, expected "
+                << graph[vertex.id()].size() << std::endl;
+        }
+        assert(edges == graph[vertex.id()]);
+        lock.lock();
+        seen[vertex.id()]++;
+        lock.unlock();
+    }
+
+    void updateByWalk(std::vector<graphchi_vertex<VertexDataType, EdgeDataType> > &vertices, vid_t vid, int sub_interval_st, int sub_interval_en, walkManager &walk_manager, graphchi_context &gcontext) {
+        check(vertices[vid - sub_interval_st]);
+        RandomWalkProgram::updateByWalk(vertices, vid, sub_interval_st, sub_interval_en, walk_manager, gcontext);
+    }
+};
+
+static std::vector<VertexDataType> run_walks(std::string filename, int nshards, int inmemory) {
+    std::stringstream ss;
+    ss << inmemory;
+    set_conf("inmemory", ss.str());
+    metrics m("test_inmemory_walks");
+    EdgeCheckProgram program;
+    program.initialization(NVERTICES, NWALKS, NSTEPS, 0, SEED);
+    /* The engine starts from zero visits without a vertex data file */
+    remove(filename_vertex_data<VertexDataType>(filename).c_str());
+    {
+        graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+        engine.run(program, 0.2, NSTEPS);
+        assert(m.get("walk_steps").value == NWALKS * NSTEPS);
+    }
+    int checked = 0;
+    for(int v=0; v < NVERTICES; v++) checked += (program.seen[v] > 0);
+    logstream(LOG_INFO) << (inmemory ? "In memory" : "Out of core") << ": checked the out-edges of " << checked << " vertices." << std::endl;
+
+    std::vector<VertexDataType> visits(NVERTICES);
+    int f = open(filename_vertex_data<VertexDataType>(filename).c_str(), O_RDONLY);
+    assert(f >= 0);
+    preada(f, &visits[0], NVERTICES * sizeof(VertexDataType), 0);
+    close(f);
+    return visits;
+}
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+
+    /* A graph with sinks, hubs and weights from 1 to 9 */
+    std::string dir = "/tmp/graphchi_inmemorytest";
+    mkdir(dir.c_str(), 0777);
+    std::string filename = dir + "/graph.txt";
+    delete_shards<EdgeDataType>(filename, 3);
+    FILE * f = fopen(filename.c_str(), "w");
+    assert(f != NULL);
+    srand(3);
+    for(int v=0; v < NVERTICES; v++) {
+        if (v % 17 == 0) continue;
+        int outdeg = 1 + rand() % (v % 5 == 0 ? 40 : 6);
+        std::map<vid_t, vid_t> targets;
+        for(int i=0; i < outdeg; i++) {
+            vid_t t = (vid_t)(i % 3 == 0 ? rand() % 10 : rand() % NVERTICES);
+            if (t != (vid_t)v) targets[t] = 1 + rand() % 9;
+        }
+        for(std::map<vid_t, vid_t>::iterator it=targets.begin(); it != targets.end(); ++it) {
+            fprintf(f, "%d %u %u\n", v, it->first, it->second);
+            graph[v].push_back(*it);
+        }
+    }
+    fclose(f);
+
+    /* The values go to the chivectors of the edges and weight the walks */
+    set_conf("filetype", "multivalueedgelist");
+    set_conf("weighted", "1");
+    bool preexisting_shards;
+    int nshards = convert_if_notexists<vid_t>(filename, "3", preexisting_shards);
+    assert(nshards == 3);
+
+    std::vector<VertexDataType> outofcore = run_walks(filename, nshards, 0);
+    std::vector<VertexDataType> inmemory = run_walks(filename, nshards, 1);
+    size_t total = 0;
+    for(int v=0; v < NVERTICES; v++) {
+        if (outofcore[v] != inmemory[v]) {
+            logstream(LOG_ERROR) << "Vertex " << v << " was visited " << outofcore[v] << " times out of core but "
+                << inmemory[v] << " times in memory." << std::endl;
+        }
+        assert(outofcore[v] == inmemory[v]);
+        total += inmemory[v];
+    }
+    /* Visits are counted at hops 1 to NSTEPS - 1 */
+    assert(total == (size_t)NWALKS * (NSTEPS - 1));
+
+    delete_shards<EdgeDataType>(filename, nshards);
+    logstream(LOG_INFO) << "In-memory walk test passed, " << total << " visits." << std::endl;
+    return 0;
+}
@@ -3,7 +3,7 @@
   * Simple utility to generate Erdos-Renyi G(n, p) graphs.
   * n = number of vertices, p = probability for each edge.
   * This requires O(n^2) time, so not good idea to define very large n.
-  * Edge direction is randomized.
+  * Edge direction is randomized. A seed makes the graph reproducible.
   */
 
 #include <stdlib.h>
@@ -13,7 +13,7 @@
 
 int main(int argc, const char ** argv) {
     if (argc < 4) {
-        printf("Usage: erdosrenyi nameprefix n p\n");
+        printf("Usage: erdosrenyi nameprefix n p [seed]\n");
         return 1;
     }   
     
@@ -29,7 +29,7 @@ int main(int argc, const char ** argv) {
     timeval tt;
     gettimeofday(&tt, NULL);
     
-    srandom(time(NULL) +  (int)tt.tv_usec);
+    srandom(argc > 4 ? atoi(argv[4]) : time(NULL) +  (int)tt.tv_usec);
 
     size_t K = 10000;
     
@@ -46,7 +46,7 @@ int main(int argc, const char ** argv) {
             size_t r = random();
             if (r % K < lim) {
                 accepted++;
-                if (rand() % 2 == 0) {
+                if (random() % 2 == 0) {
                     fprintf(f, "%d\t%d\n", i, j);
                 } else {
                     fprintf(f, "%d\t%d\n", j, i);
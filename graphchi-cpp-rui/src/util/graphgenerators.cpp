@@ -14,10 +14,39 @@
 #include <cstdio>
 #include <sys/time.h>
 #include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * R-MAT edge: the adjacency matrix is split into quadrants recursively,
+ * picking the top left, top right and bottom left one with probability
+ * a, b and c (Graph500 parameters).
+ */
+static std::pair<int, int> rmat_edge(int scale) {
+    const double a = 0.57, b = 0.19, c = 0.19;
+    int from = 0, to = 0;
+    for(int i = 0; i < scale; i++) {
+        double r = random() / (RAND_MAX + 1.0);
+        from <<= 1;
+        to <<= 1;
+        if (r < a) {
+        } else if (r < a + b) {
+            to |= 1;
+        } else if (r < a + b + c) {
+            from |= 1;
+        } else {
+            from |= 1;
+            to |= 1;
+        }
+    }
+    return std::make_pair(from, to);
+}
 
 int main(int argc, const char ** argv) {
     if (argc < 3) {
         printf("Usage: generate type n\n");
+        printf("       generate rmat scale [edgefactor] [seed]\n");
         return 1;
     }
     
@@ -107,5 +136,26 @@ int main(int argc, const char ** argv) {
         }
     }
     
+    /* 2^n vertices and edgefactor * 2^n edges, without self-loops and
+       duplicates, sorted by source */
+    if (type == "rmat") {
+        int edgefactor = argc > 3 ? atoi(argv[3]) : 16;
+        timeval tt;
+        gettimeofday(&tt, NULL);
+        srandom(argc > 4 ? atoi(argv[4]) : time(NULL) + (int)tt.tv_usec);
+        size_t nedges = (size_t)edgefactor << n;
+        std::vector< std::pair<int, int> > edges;
+        edges.reserve(nedges);
+        for(size_t e = 0; e < nedges; e++) {
+            std::pair<int, int> edge = rmat_edge(n);
+            if (edge.first != edge.second) edges.push_back(edge);
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        for(size_t e = 0; e < edges.size(); e++) {
+            fprintf(f, "%d %d\n", edges[e].first, edges[e].second);
+        }
+    }
+    
     fclose(f);
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef DEF_INDEXED_MAXHEAP
+#define DEF_INDEXED_MAXHEAP
+
+#include <assert.h>
+#include <vector>
+
+/**
+ * Max-heap over the ids 0..n-1 whose keys can be changed in place.
+ * update() restores the heap order for one id in O(log n).
+ */
+template <typename K>
+class indexed_maxheap {
+    std::vector<int> heap;    // heap position -> id
+    std::vector<int> pos;     // id -> heap position
+    std::vector<K> keys;
+    
+    inline int parent(int i) { return (i+1)/2-1; }
+    inline int left(int i)   { return i*2 + 1; }
+    inline int right(int i)  { return i*2 + 2; }
+    
+    inline void swap(int i, int j) {
+        int tmp = heap[i];
+        heap[i] = heap[j];
+        heap[j] = tmp;
+        pos[heap[i]] = i;
+        pos[heap[j]] = j;
+    }
+    
+    void siftUp(int i) {
+        while (i > 0 && keys[heap[parent(i)]] < keys[heap[i]]) {
+            swap(i, parent(i));
+            i = parent(i);
+        }
+    }
+    
+    void siftDown(int i) {
+        int sz = (int)heap.size();
+        while (true) {
+            int l = left(i);
+            int r = right(i);
+            int largest = i;
+            if (l < sz && keys[heap[largest]] < keys[heap[l]]) largest = l;
+            if (r < sz && keys[heap[largest]] < keys[heap[r]]) largest = r;
+            if (largest == i) return;
+            swap(i, largest);
+            i = largest;
+        }
+    }
+    
+public:
+    indexed_maxheap() {}
+    
+    indexed_maxheap(int n) {
+        resize(n);
+    }
+    
+    /* All keys start as K(). */
+    void resize(int n) {
+        heap.resize(n);
+        pos.resize(n);
+        keys.assign(n, K());
+        for(int i = 0; i < n; i++) {
+            heap[i] = i;
+            pos[i] = i;
+        }
+    }
+    
+    int size() { return (int)heap.size(); }
+    
+    K key(int id) { return keys[id]; }
+    
+    void update(int id, K key) {
+        K old = keys[id];
+        keys[id] = key;
+        if (old < key) siftUp(pos[id]);
+        else siftDown(pos[id]);
+    }
+    
+    /* Id with the largest key. */
+    int top() {
+        assert(heap.size() > 0);
+        return heap[0];
+    }
+    
+    K topkey() {
+        return keys[top()];
+    }
+};
+
+#endif
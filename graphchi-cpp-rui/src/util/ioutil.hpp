@@ -32,7 +32,14 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
 #include <zlib.h>
+#ifdef GRAPHCHI_LZ4
+#include <lz4.h>
+#endif
+#ifdef GRAPHCHI_ZSTD
+#include <zstd.h>
+#endif
  
 
 // Reads given number of bytes to a buffer
@@ -139,12 +146,143 @@ void writea(int f, T * tbuf, size_t nbytes) {
  * COMPRESSED
  */
 
+/**
+ * Codecs of compressed blocks. A zlib block is a bare zlib stream, like
+ * every block written before there was a choice; a block of any other
+ * codec starts with the magic "GCB" and the codec byte. The first byte of
+ * a zlib stream always has 8 (deflate) in its low nibble, so it can never
+ * be taken for the magic, and blocks of all codecs can be mixed in a shard.
+ * LZ4 and Zstd are built in with GRAPHCHI_LZ4 and GRAPHCHI_ZSTD.
+ */
+enum block_codec_t { BLOCK_CODEC_ZLIB = 0, BLOCK_CODEC_NONE = 1, BLOCK_CODEC_LZ4 = 2, BLOCK_CODEC_ZSTD = 3 };
+
+#define BLOCK_CODEC_HEADER 4
+
+#ifndef GRAPHCHI_ZSTD_LEVEL
+#define GRAPHCHI_ZSTD_LEVEL 1
+#endif
+
+static inline const char * block_codec_name(block_codec_t codec) {
+    switch(codec) {
+        case BLOCK_CODEC_ZLIB: return "zlib";
+        case BLOCK_CODEC_NONE: return "none";
+        case BLOCK_CODEC_LZ4: return "lz4";
+        case BLOCK_CODEC_ZSTD: return "zstd";
+    }
+    return "unknown";
+}
+
+static inline bool block_codec_available(block_codec_t codec) {
+#ifndef GRAPHCHI_LZ4
+    if (codec == BLOCK_CODEC_LZ4) return false;
+#endif
+#ifndef GRAPHCHI_ZSTD
+    if (codec == BLOCK_CODEC_ZSTD) return false;
+#endif
+    return true;
+}
+
+/* Writes a block with a header, any codec but zlib. */
+static inline size_t write_coded_block(int f, const void * buf, size_t nbytes, block_codec_t codec) {
+    if (!block_codec_available(codec)) {
+        logstream(LOG_FATAL) << "Block codec " << block_codec_name(codec) << " was not built in." << std::endl;
+        assert(false);
+    }
+    size_t bound = nbytes;
+#ifdef GRAPHCHI_LZ4
+    if (codec == BLOCK_CODEC_LZ4) bound = LZ4_compressBound((int) nbytes);
+#endif
+#ifdef GRAPHCHI_ZSTD
+    if (codec == BLOCK_CODEC_ZSTD) bound = ZSTD_compressBound(nbytes);
+#endif
+    unsigned char * out = (unsigned char *) malloc(BLOCK_CODEC_HEADER + bound);
+    memcpy(out, "GCB", 3);
+    out[3] = (unsigned char) codec;
+    size_t len = nbytes;
+    if (codec == BLOCK_CODEC_NONE) {
+        memcpy(out + BLOCK_CODEC_HEADER, buf, nbytes);
+    }
+#ifdef GRAPHCHI_LZ4
+    if (codec == BLOCK_CODEC_LZ4) {
+        int ret = LZ4_compress_default((const char *) buf, (char *) out + BLOCK_CODEC_HEADER, (int) nbytes, (int) bound);
+        assert(ret > 0);
+        len = ret;
+    }
+#endif
+#ifdef GRAPHCHI_ZSTD
+    if (codec == BLOCK_CODEC_ZSTD) {
+        len = ZSTD_compress(out + BLOCK_CODEC_HEADER, bound, buf, nbytes, GRAPHCHI_ZSTD_LEVEL);
+        if (ZSTD_isError(len)) {
+            logstream(LOG_FATAL) << "Zstd compression failed: " << ZSTD_getErrorName(len) << std::endl;
+            assert(false);
+        }
+    }
+#endif
+    int trerr = ftruncate(f, 0);
+    assert (trerr == 0);
+    pwritea(f, out, BLOCK_CODEC_HEADER + len, 0);
+    free(out);
+    return BLOCK_CODEC_HEADER + len;
+}
+
+/* Reads a block with a header of fsize bytes into buf of nbytes. */
+static inline void read_coded_block(int f, void * buf, size_t nbytes, size_t fsize, block_codec_t codec) {
+    if (!block_codec_available(codec)) {
+        logstream(LOG_FATAL) << "Block codec " << block_codec_name(codec) << " was not built in, "
+            << "cannot read the block. Rebuild with GRAPHCHI_LZ4 or GRAPHCHI_ZSTD." << std::endl;
+        assert(false);
+    }
+    size_t len = fsize - BLOCK_CODEC_HEADER;
+    if (codec == BLOCK_CODEC_NONE) {
+        assert(len == nbytes);
+        preada(f, buf, nbytes, BLOCK_CODEC_HEADER);
+        return;
+    }
+    char * in = (char *) malloc(len);
+    preada(f, in, len, BLOCK_CODEC_HEADER);
+#ifdef GRAPHCHI_LZ4
+    if (codec == BLOCK_CODEC_LZ4) {
+        int ret = LZ4_decompress_safe(in, (char *) buf, (int) len, (int) nbytes);
+        if (ret != (int) nbytes) {
+            logstream(LOG_FATAL) << "Corrupt LZ4 block: got " << ret << " bytes, expected " << nbytes << std::endl;
+            assert(false);
+        }
+    }
+#endif
+#ifdef GRAPHCHI_ZSTD
+    if (codec == BLOCK_CODEC_ZSTD) {
+        size_t ret = ZSTD_decompress(buf, nbytes, in, len);
+        if (ZSTD_isError(ret) || ret != nbytes) {
+            logstream(LOG_FATAL) << "Corrupt Zstd block: " << (ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "short block") << std::endl;
+            assert(false);
+        }
+    }
+#endif
+    free(in);
+}
+
+/* The codec of a block file, zlib for a bare zlib stream. */
+static inline block_codec_t read_block_codec(int f, size_t fsize) {
+    unsigned char hdr[BLOCK_CODEC_HEADER];
+    if (fsize < BLOCK_CODEC_HEADER) return BLOCK_CODEC_ZLIB;
+    preada(f, hdr, BLOCK_CODEC_HEADER, 0);
+    if (memcmp(hdr, "GCB", 3) != 0) return BLOCK_CODEC_ZLIB;
+    if (hdr[3] == BLOCK_CODEC_ZLIB || hdr[3] > BLOCK_CODEC_ZSTD) {
+        logstream(LOG_FATAL) << "Unknown block codec " << (int) hdr[3] << std::endl;
+        assert(false);
+    }
+    return (block_codec_t) hdr[3];
+}
+
 
 
 template <typename T>
-size_t write_compressed(int f, T * tbuf, size_t nbytes) {
+size_t write_compressed(int f, T * tbuf, size_t nbytes, block_codec_t codec=BLOCK_CODEC_ZLIB) {
     
 #ifndef GRAPHCHI_DISABLE_COMPRESSION
+    if (codec != BLOCK_CODEC_ZLIB) {
+        return write_coded_block(f, tbuf, nbytes, codec);
+    }
     unsigned char * buf = (unsigned char*)tbuf;
     int ret;
     unsigned have;
@@ -198,7 +336,7 @@ size_t write_compressed(int f, T * tbuf, size_t nbytes) {
 
 }
 
-/* Zlib-inflated read. Assume tbuf is correctly sized memory block. */
+/* Read of a compressed block of any codec. Assume tbuf is correctly sized memory block. */
 template <typename T>
 void read_compressed(int f, T * tbuf, size_t nbytes) {
 #ifndef GRAPHCHI_DISABLE_COMPRESSION
@@ -209,6 +347,11 @@ void read_compressed(int f, T * tbuf, size_t nbytes) {
     int CHUNK = (int) std::max((size_t)1024 * 1024, nbytes);
 
     size_t fsize = lseek(f, 0, SEEK_END);
+    block_codec_t codec = read_block_codec(f, fsize);
+    if (codec != BLOCK_CODEC_ZLIB) {
+        read_coded_block(f, tbuf, nbytes, fsize, codec);
+        return;
+    }
     
     unsigned char * in = (unsigned char *) malloc(fsize);
     lseek(f, 0, SEEK_SET);
@@ -9,6 +9,7 @@
 #include "graphchi_basic_includes.hpp"
 #include "api/dynamicdata/chivector.hpp"
 #include "walks/walk.hpp"   // -Rui
+#include "walks/walkrandom.hpp"
 #include "util/toplist.hpp"
 #include "metrics/metrics.hpp"
 
@@ -29,16 +30,28 @@ private:
     int nsteps;
     int nvertices;
     float boundRatio,  intervalBoundRatio;
+    unsigned seed;
 
 public:
+    /* Stream of the start vertices, apart from the streams of the steps */
+    static const uint32_t START_STREAM = 1;
+    /* Start vertices are drawn this many at a time */
+    static const int START_BATCH = 4096;
+
 /*    int degree;
     int count;*/
-    void initialization( int nv, int nw, int ns, float rb ) {
+    void initialization( int nv, int nw, int ns, float rb, unsigned sd ) {
         nvertices = nv;
         nwalks = nw;
         nsteps = ns;
         boundRatio = rb;
+        seed = sd;
         std::cout << nv << " " << nw << " " << ns << " " << rb << std::endl;
+        if ((unsigned)nsteps > walk_encoding::max_hop()) {
+            logstream(LOG_FATAL) << "Walks of " << nsteps << " steps do not fit into " << walk_encoding::HOP_BITS
+                << " hop bits. Rebuild with WALK64=1." << std::endl;
+        }
+        assert((unsigned)nsteps <= walk_encoding::max_hop());
     }
 
     void startWalks( walkManager &walk_manager ){
@@ -48,13 +61,18 @@ public:
         std::cout << startWalksNum << " " << stopWalksNum << std::endl;
         walk_manager.getWalkNum(nwalks, stopWalksNum);
 
-        srand((unsigned)time(NULL));
-        for( int i = 0; i < startWalksNum; i++ ){
-            vid_t s = rand() % nvertices;
-            WalkDataType walk = walk_manager.encode(s, 0);
-            walk_manager.addWalk(s, walk );
-            // std::cout << "s     " << s << " " <<  i  << " " << nvertices << std::endl;
-            // std::cout << walk << "  " << walk_manager.getSourceId(walk) << " " << walk_manager.getHop(walk) << std::endl;
+        /* Only the random and minstep schedulers draw from rand(), on the engine thread */
+        srand(seed);
+        int batch = START_BATCH;
+        std::vector<uint32_t> bound(batch, nvertices), start(batch);
+        for( int first = 0; first < startWalksNum; first += batch ){
+            int n = std::min(batch, startWalksNum - first);
+            random_batch(seed, first, 0, START_STREAM, &bound[0], &start[0], n);
+            for( int j = 0; j < n; j++ ){
+                vid_t s = start[j];
+                WalkDataType walk = walk_manager.encode(s, 0);
+                walk_manager.addWalk(s, walk, first + j );
+            }
         }
 /*        degree = 0;
         count = 0;*/
@@ -67,44 +85,21 @@ public:
                                                                                                                 graphchi_context &gcontext) {
         // int num_walks = 0;
         while( !walk_manager.emptyWalk( vertex.id() ) ){
-            WalkDataType walk = walk_manager.getWalk( vertex.id() );
-            if( walk_manager.getHop(walk) <  nsteps ){
-                if( walk_manager.getHop(walk) > 0 )
-                #pragma omp critical
-                    {
-                        vertex.set_data(vertex.get_data() + 1 );
-                    }
+            WalkRecord rec = walk_manager.getWalk( vertex.id() );
+            int hop = walk_manager.getHop(rec.walk);
+            if( hop > 0 )
+                walk_manager.visits.visit( vertex.id() );
+            if( hop <  nsteps ){
                 /* Move to a random out-edge */
-                graphchi_edge<EdgeDataType> * outedge = vertex.random_outedge();
+                walkRandom rng(seed, rec.id, hop);
+                graphchi_edge<EdgeDataType> * outedge = vertex.random_outedge(rng, gcontext.aliases);
                 if (outedge != NULL) {
-                // Rui adds critical 
-                #pragma omp critical
-                {
-                    walk_manager.moveWalk( walk, outedge->vertex_id());
-                     // std::cout << vertex.id() << "    ->    " << outedge->vertex_id() << std::endl;
-                }
+                    walk_manager.moveWalk( rec, outedge->vertex_id());
                 }else{ // sink node
-                    vid_t s = rand() % nvertices;
-                    // Rui adds critical
-                    #pragma omp critical
-                    {
-                        walk_manager.moveWalk( walk, s );
-                    }
-                    // walk_manager.moveWalk( walk, walk_manager.getSourceId(walk) );
-                    // std::cout << walk << "  " << walk_manager.getSourceId(walk) << " " << walk_manager.getHop(walk) << std::endl;
-                    // std::cout << vertex.id() << "    ->    " << walk_manager.getSourceId(walk) << std::endl;
-                }
-                /*degree += vertex.num_inedges() + vertex.num_outedges();
-                count++;
-                num_walks ++;*/
-            }else{
-                // degree += vertex.num_inedges() + vertex.num_outedges();
-                // count++;
-                // Rui adds critical
-                #pragma omp critical
-                {
-                    vertex.set_data(vertex.get_data() + 1 );
+                    vid_t s = rng.below(nvertices);
+                    walk_manager.moveWalk( rec, s );
                 }
+                walk_manager.walked(1);
             }
         }
         // vertex.set_data(vertex.get_data() + num_walks);
@@ -138,33 +133,29 @@ public:
         // std::cout << "update by walk start" << std::endl;
         graphchi_vertex<VertexDataType, EdgeDataType> &vertex = vertices[vid - sub_interval_st];
         while (!walk_manager.emptyWalk(vertex.id())){
-            WalkDataType nowWalk = walk_manager.getWalk(vertex.id());
-             // std::cout << vertex.id() << " : walk " << nowWalk << std::endl;
-            int hop = walk_manager.getHop(nowWalk);
+            WalkRecord rec = walk_manager.getWalk(vertex.id());
+            int hop = walk_manager.getHop(rec.walk), starthop = hop;
             // std::cout << vertex.id() << " : hop" << hop << std::endl;
             vid_t dstId = vertex.id();
             while (dstId >= (vid_t)sub_interval_st && dstId <= (vid_t)sub_interval_en && hop < nsteps ){
                 // std::cout << vertex.id() << " " << dstId << std::endl;
                 graphchi_vertex<VertexDataType, EdgeDataType> &nowVertex = vertices[dstId-sub_interval_st];
-                 if( hop > 0 )
-                 #pragma omp critical
-                    {
-                        nowVertex.set_data(vertex.get_data() + 1 );
-                    }
+                if( hop > 0 )
+                    walk_manager.visits.visit( nowVertex.id() );
                 /*degree += nowVertex.num_edges();
                 count++;*/
                 //nowVertex.set_data(nowVertex.get_data()+1);
-                graphchi_edge<EdgeDataType> * outedge = nowVertex.random_outedge();
+                walkRandom rng(seed, rec.id, hop);
+                graphchi_edge<EdgeDataType> * outedge = nowVertex.random_outedge(rng, gcontext.aliases);
                 if (outedge != NULL)
                     dstId = outedge -> vertex_id();
                 else
-                    dstId = rand() % nvertices;
+                    dstId = rng.below(nvertices);
                 hop++;
             }
+            walk_manager.walked(hop - starthop);
             if( hop < nsteps  ){
-                walk_manager.moveWalktoHop(nowWalk, dstId, hop);
-                if( dstId >= (vid_t)sub_interval_st && dstId <= (vid_t)sub_interval_en)
-                    std::cout << vertex.id() << " move walk " << nowWalk << "  " << dstId << "  " << hop << std::endl;
+                walk_manager.moveWalktoHop(rec, dstId, hop);
             }
         }
         // std::cout << "update by walk end" << std::endl;
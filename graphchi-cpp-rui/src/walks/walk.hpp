@@ -15,11 +15,100 @@
 #include "metrics/metrics.hpp"
 #include "io/stripedio.hpp"
 #include "graphchi_types.hpp"
+#include "util/indexed_maxheap.hpp"
+#include "util/pthread_tools.hpp"
+#include "walks/walktype.hpp"
 
 
 namespace graphchi {
 
-	typedef unsigned int WalkDataType;
+#define WALK_MAX_THREADS 256
+
+	/* A queued walk with its id, which keys the random numbers of its steps */
+	struct WalkRecord {
+		WalkDataType walk;
+		uint32_t id;
+	};
+
+	static inline WalkRecord make_walk_record( WalkDataType walk, uint32_t id ){
+		WalkRecord rec;
+		rec.walk = walk;
+		rec.id = id;
+		return rec;
+	}
+
+	/**
+	 * Small dense id of the calling thread. OpenMP thread numbers repeat
+	 * across the teams of nested parallel regions, these ids do not.
+	 */
+	static int walk_thread_slot() {
+		static int nslots = 0;
+		static __thread int slot = -1;
+		if( slot < 0 ){
+			slot = __sync_fetch_and_add(&nslots, 1);
+			assert( slot < WALK_MAX_THREADS );
+		}
+		return slot;
+	}
+
+	/**
+	 * Counts walk visits of the vertices of the current interval without
+	 * locking: every thread increments its own dense array, and the arrays
+	 * are added into the vertex values when the interval is done.
+	 */
+	class visitCounter
+	{
+		struct shard {
+			std::vector< unsigned > counts;
+			bool used;
+		} __attribute__((aligned(64)));
+		std::vector< shard > shards;
+		vid_t st, en;
+	public:
+		visitCounter() : shards(WALK_MAX_THREADS), st(0), en(0) {
+			reset();
+		}
+
+		/* Drops the counts, e.g. when they are not stored. */
+		void reset(){
+			for( unsigned i = 0; i < shards.size(); i++ )
+				shards[i].used = false;
+		}
+
+		void begin( vid_t _st, vid_t _en ){
+			st = _st;
+			en = _en;
+		}
+
+		void visit( vid_t v ){
+			shard &s = shards[walk_thread_slot()];
+			if( !s.used ){
+				s.counts.assign(en - st + 1, 0);
+				s.used = true;
+			}
+			s.counts[v - st]++;
+		}
+
+		/* Adds the counts to the data of the interval vertices and resets them. */
+		template <typename svertex_t>
+		void flush( std::vector<svertex_t> &vertices ){
+			std::vector< int > used;
+			for( int i = 0; i < (int)shards.size(); i++ )
+				if( shards[i].used ) used.push_back(i);
+			if( used.empty() ) return;
+			int n = (int)(en - st + 1);
+			#pragma omp parallel for
+			for( int i = 0; i < n; i++ ){
+				unsigned c = 0;
+				for( unsigned j = 0; j < used.size(); j++ )
+					c += shards[used[j]].counts[i];
+				if( c > 0 )
+					vertices[i].set_data(vertices[i].get_data() + c);
+			}
+			for( unsigned j = 0; j < used.size(); j++ )
+				shards[used[j]].used = false;
+		}
+	};
 
 	class walkManager
 	{
@@ -27,11 +116,29 @@ namespace graphchi {
 		int nshards, num_vertex;
 		int nwalks,  lowerBound, intervalLowerBound;
 		std::string walk_filename;
-		std::vector< std::queue <WalkDataType> > walks;
+		std::vector< std::queue <WalkRecord> > walks;
 		std::vector< std::pair<vid_t, vid_t> > intervals;
+		/* Walk counts maintained incrementally, so scheduling does not scan the vertices */
+		std::vector< int > walknum;
+		long totalwalks;
+		indexed_maxheap<int> intervalheap;
+		/* Intervals whose count changed since the heap was last brought up to date */
+		std::vector< char > dirty;
+		std::vector< int > dirtylist;
+		spinlock dirtylock;
+		/* Walks moved by each thread, merged into the vertex queues after the parallel loop */
+		struct outbox {
+			std::vector< std::pair<vid_t, WalkRecord> > walks;
+			/* Walk steps taken by the thread */
+			long steps;
+		} __attribute__((aligned(64)));
+		std::vector< outbox > outboxes;
 		metrics &m;
 	public:
+		/* Fewest hops of a walk queued in each interval, NO_WALK for an interval without walks */
 		std::vector<int> minstep;
+		enum { NO_WALK = 0xfffffff };
+		visitCounter visits;
 		walkManager( metrics &_m) : m(_m){}
 		~walkManager(){
 			walks.clear();
@@ -52,9 +159,15 @@ namespace graphchi {
 
 			intervals = in;
 
-			minstep.resize(nshards);
-			for( int i = 0; i < nshards; i++ )
-				minstep[i] = 0;
+			walknum.assign(nshards, 0);
+			totalwalks = 0;
+			intervalheap.resize(nshards);
+			dirty.assign(nshards, 0);
+
+			minstep.assign(nshards, NO_WALK);
+			outboxes.resize(WALK_MAX_THREADS);
+			for( unsigned t = 0; t < outboxes.size(); t++ )
+				outboxes[t].steps = 0;
 		}
 
 		void getWalkNum(int nw, int stopnw){
@@ -63,32 +176,64 @@ namespace graphchi {
 		}
 
 		WalkDataType encode( vid_t sourceId, int hop ){
-			assert( hop < 512 );
-			return (( sourceId & 0x7fffff ) << 9 ) | ( hop & 0x1ff ) ;
+			return walk_encoding::encode(sourceId, hop);
 		}
 
 		vid_t getSourceId( WalkDataType walk ){
-			return ( walk >> 9 ) & 0x7fffff;
+			return walk_encoding::source(walk);
 		}
 
 		int getHop( WalkDataType walk ){
-			return (walk & 0x1ff) ;
+			return walk_encoding::hop(walk);
 		}
 
 		WalkDataType reencode( WalkDataType walk, vid_t toVertex ){
-			int hop = getHop(walk) + 1;
-			assert( hop < 512 );
-			return (walk + 1);
+			return walk_encoding::set_hop(walk, walk_encoding::hop(walk) + 1);
+		}
+
+		/* Counts are updated atomically, as walks are moved from the parallel update loop. */
+		void countWalk( int p, int delta ){
+			__sync_fetch_and_add(&walknum[p], delta);
+			__sync_fetch_and_add(&totalwalks, (long)delta);
+			if( !dirty[p] && __sync_bool_compare_and_swap(&dirty[p], 0, 1) ){
+				dirtylock.lock();
+				dirtylist.push_back(p);
+				dirtylock.unlock();
+			}
+		}
+
+		void updateHeap(){
+			for( unsigned i = 0; i < dirtylist.size(); i++ ){
+				int p = dirtylist[i];
+				dirty[p] = 0;
+				intervalheap.update(p, walknum[p]);
+			}
+			dirtylist.clear();
 		}
 
-		WalkDataType getWalk( int v ){
-			WalkDataType walk = walks[v].front();
+		WalkRecord getWalk( int v ){
+			WalkRecord rec = walks[v].front();
 			walks[v].pop();
-			return walk;
+			countWalk(findInvl(v), -1);
+			return rec;
+		}
+
+		/* Adds walk id outside of parallel regions, e.g. when the walks are started. */
+		void addWalk( int v, WalkDataType walk, uint32_t id ){
+			walks[v].push( make_walk_record(walk, id) );
+			int p = findInvl(v);
+			countWalk(p, 1);
+			if( getHop(walk) < minstep[p] )
+				minstep[p] = getHop(walk);
 		}
 
-		void addWalk( int v, WalkDataType walk ){
-			walks[v].push( walk );
+		/**
+		 * Called before a pass takes every walk out of the queues of
+		 * interval p. The walks that are merged back into p during the
+		 * pass then give its minimum hop anew.
+		 */
+		void beginPass( int p ){
+			minstep[p] = NO_WALK;
 		}
 
 		int getWalkSize(int v){
@@ -96,48 +241,66 @@ namespace graphchi {
 		}
 
 		int getWalksDis( int p ){
-			int walknum = 0;
-		  	for( unsigned int i = intervals[p].first; i <= intervals[p].second; i++ ){
-		  		walknum += walks[i].size();
-	          	}
-	          	return walknum;
+			return walknum[p];
 		}
 
-		void moveWalktoHop( WalkDataType walk, vid_t toVertex, int hop ){
-			walk = encode(getSourceId(walk), hop);
-			walks[toVertex].push( walk );
-
-			int curp = findInvl(toVertex);
-			if( getHop(walk) < minstep[curp] )
-				minstep[curp] = getHop(walk);
+		/* Thread-safe: counts steps walk steps of the calling thread. */
+		void walked( long steps ){
+			outboxes[walk_thread_slot()].steps += steps;
 		}
 
-		void moveWalk( WalkDataType walk, vid_t toVertex ){
-			walk = reencode( walk, toVertex );
-			walks[toVertex].push( walk );
+		/* Walk steps taken so far; called outside of parallel regions. */
+		long totalSteps(){
+			long steps = 0;
+			for( unsigned t = 0; t < outboxes.size(); t++ )
+				steps += outboxes[t].steps;
+			return steps;
+		}
 
-			int curp = findInvl(toVertex);
-			if( getHop(walk) < minstep[curp] )
-				minstep[curp] = getHop(walk);
+		/* Thread-safe: the walk goes to the outbox of the calling thread. */
+		void moveWalktoHop( WalkRecord rec, vid_t toVertex, int hop ){
+			rec.walk = encode(getSourceId(rec.walk), hop);
+			outboxes[walk_thread_slot()].walks.push_back(std::make_pair(toVertex, rec));
+		}
 
-			//print the vertices trace of a long walk
-			/*std::ofstream ofs;
-			ofs.open(walk_filename.c_str(), std::ofstream::out | std::ofstream::app );
-		      ofs << " -> " << toVertex;
-		      ofs.close();*/
+		void moveWalk( WalkRecord rec, vid_t toVertex ){
+			rec.walk = reencode( rec.walk, toVertex );
+			outboxes[walk_thread_slot()].walks.push_back(std::make_pair(toVertex, rec));
+		}
 
-			//print the interval trace of a long walk
-	          	/*std::ofstream ofs;
-			ofs.open(walk_filename.c_str(), std::ofstream::out | std::ofstream::app );
-			ofs << curp << std::endl;
-		      ofs.close();*/	
+		/* Moves the walks of all outboxes to their vertices; called outside of parallel regions. */
+		void mergeOutboxes(){
+			metrics_entry me = m.start_time();
+			for( unsigned t = 0; t < outboxes.size(); t++ ){
+				std::vector< std::pair<vid_t, WalkRecord> > &box = outboxes[t].walks;
+				for( unsigned i = 0; i < box.size(); i++ ){
+					vid_t toVertex = box[i].first;
+					WalkDataType walk = box[i].second.walk;
+					walks[toVertex].push( box[i].second );
+					int curp = findInvl(toVertex);
+					walknum[curp]++;
+					totalwalks++;
+					if( !dirty[curp] ){
+						dirty[curp] = 1;
+						dirtylist.push_back(curp);
+					}
+					if( getHop(walk) < minstep[curp] )
+						minstep[curp] = getHop(walk);
+				}
+				box.clear();
+			}
+			m.stop_time(me, "_merge-outboxes");
 		}
 
+		/* Binary search over the interval upper bounds. */
 		int findInvl( vid_t v ){
-			for( int p = 0; p < nshards; p++ )
-		  		if( v <= intervals[p].second )
-		  			return p;
-	          	return nshards;
+			int lo = 0, hi = nshards;
+			while( lo < hi ){
+				int mid = (lo + hi) / 2;
+				if( v <= intervals[mid].second ) hi = mid;
+				else lo = mid + 1;
+			}
+			return lo;
 		}
 
 		bool emptyWalk( unsigned int v ){
@@ -145,51 +308,24 @@ namespace graphchi {
 		}
 
 		bool notFinishInterval( int p ){
-			metrics_entry me = m.start_time();
-			int walknum = 0;
-		  	for( unsigned int i = intervals[p].first; i <= intervals[p].second; i++ ){
-		  		walknum += walks[i].size();
-	          		// std::cout << "notFinishInterval interval : " << i << " " << walknum << " " << 0 << std::endl;
-	          	}
-	          	m.stop_time(me, "_check-interval-finish");
-	          	// std::cout << "notFinishInterval (walknum, walknum>0? ): " << walknum << " " << (walknum > 0) << std::endl;
-	          	return walknum > 0;
+			return walknum[p] > 0;
 		}
 
 	     bool notFinish(){
-	     		metrics_entry me = m.start_time();
-	     		int sum = 0;
-	          	for(int i=0; i < num_vertex; i++){
-	          		sum += walks[i].size();
-	          		if( sum > lowerBound ){
-	          			m.stop_time(me, "_check-finish");
-	          			// std::cout << "notFinish ( i, sum ) : " << i << " , " << sum << std::endl;
-	          			return true;
-	          		}
-	          	}
-	          	m.stop_time(me, "_check-finish");
-	          	return false;
+	     		return totalwalks > lowerBound;
 	     }
 
 	     int intervalWithMaxWalks(){
 	     		metrics_entry me = m.start_time();
-	     		int maxw = 0, maxp = 0;
-	          	for(int p = 0; p < nshards; p++) {
-		  		int walknum = 0;
-		  		for( unsigned int i = intervals[p].first; i <= intervals[p].second; i++ )
-		  			walknum += walks[i].size();
-		      	if( maxw < walknum ){
-	          			maxw = walknum;
-	          			maxp = p;
-	          		}
-		   	}
+	     		updateHeap();
+	     		int maxp = intervalheap.top();
 	          	m.stop_time(me, "_find-interval-with-max-walks");
 	          	return maxp;
 	     }
 
 	     int intervalWithMinStep(){
 	     		metrics_entry me = m.start_time();
-	     		int mins = 0xfffffff, minp = 0;
+	     		int mins = NO_WALK, minp = 0;
 	          	for(int p = 0; p < nshards; p++) {
 			      	if( mins > minstep[p] ){
 	          			mins = minstep[p];
@@ -205,11 +341,8 @@ namespace graphchi {
 	     		float maxwt = 0;
 	     		int maxp = 0;
 	          	for(int p = 0; p < nshards; p++) {
-		  		int walknum = 0;
-		  		for( unsigned int i = intervals[p].first; i <= intervals[p].second; i++ )
-		  			walknum += walks[i].size();
-		      		if(  maxwt < (float)walknum/minstep[p] ){
-	          			maxwt = (float)walknum/minstep[p];
+		      		if(  maxwt < (float)walknum[p]/minstep[p] ){
+	          			maxwt = (float)walknum[p]/minstep[p];
 	          			maxp = p;
 	          		}
 		   	}
@@ -229,18 +362,7 @@ namespace graphchi {
 	     		std::ofstream ofs;
 		     ofs.open(walk_filename.c_str(), std::ofstream::out | std::ofstream::app );
 		  	// ofs << "walksvector after exec_interval:  " << exec_interval << std::endl;
-		   	int sum = 0;
-		   	int *walknum = new int[nshards];
-		  	for(int p = 0; p < nshards; p++) {
-		  		walknum[p] = 0;
-		  		for( unsigned int i = intervals[p].first; i <= intervals[p].second; i++ )
-		  			walknum[p] += walks[i].size();
-		      	sum += walknum[p];
-		      	//ofs << p  << ":( " << walknum[p] << " ) \t ";
-		   	}
-		  	// ofs << " Sum : " << sum << std::endl;
-		  	ofs << exec_interval << " \t " << walknum[exec_interval] << " \t " << sum << std::endl;
-		  	delete walknum;
+		  	ofs << exec_interval << " \t " << walknum[exec_interval] << " \t " << totalwalks << std::endl;
 		 	ofs.close();
 		 	m.stop_time(me, "_print-walks-distribution");
 	     }
@@ -0,0 +1,89 @@
+#ifndef DEF_GRAPHCHI_WALKRANDOM
+#define DEF_GRAPHCHI_WALKRANDOM
+
+#include <stdint.h>
+
+#define PHILOX_M2x32 0xD256D193u
+#define PHILOX_W32 0x9E3779B9u
+
+namespace graphchi {
+
+    /**
+     * Counter-based random numbers for walks (Philox-2x32-10). A number is a
+     * pure function of the seed, the walk id, the hop and a draw counter, so
+     * threads share no generator state and a walk takes the same path
+     * whichever thread executes it and however the walks are scheduled.
+     * Same generator as in GraphWalker.
+     */
+    static inline uint64_t philox2x32( uint64_t ctr, uint32_t key ){
+        uint32_t L = (uint32_t)(ctr >> 32), R = (uint32_t)ctr;
+        for( int r = 0; r < 10; r++ ){
+            uint64_t prod = (uint64_t)PHILOX_M2x32 * L;
+            uint32_t hi = (uint32_t)(prod >> 32), lo = (uint32_t)prod;
+            L = hi ^ key ^ R;
+            R = lo;
+            key += PHILOX_W32;
+        }
+        return ((uint64_t)L << 32) | R;
+    }
+
+    /* Maps a 32-bit random number to [0, bound) by multiplication (Lemire). */
+    static inline uint32_t random_below( uint32_t x, uint32_t bound ){
+        return (uint32_t)(((uint64_t)x * bound) >> 32);
+    }
+
+    /**
+     * Random stream of one walk at one hop. A hop may draw up to 2^16
+     * numbers; streams of different seeds, walks or hops do not overlap.
+     */
+    class walkRandom
+    {
+    private:
+        uint32_t key;
+        uint64_t ctr;
+        uint32_t spare;
+        bool hasspare;
+    public:
+        /* The stream separates uses of the same walk and hop, e.g. picking start vertices. */
+        walkRandom( uint32_t seed, uint32_t walkid, unsigned hop, uint32_t stream = 0 )
+            : key(seed ^ (stream * PHILOX_W32)), ctr(((uint64_t)walkid << 32) | ((uint64_t)(hop & 0xffff) << 16)), spare(0), hasspare(false) {}
+
+        uint32_t next(){
+            if( hasspare ){
+                hasspare = false;
+                return spare;
+            }
+            uint64_t x = philox2x32(ctr++, key);
+            spare = (uint32_t)x;
+            hasspare = true;
+            return (uint32_t)(x >> 32);
+        }
+
+        /* Uniform in [0, bound). */
+        uint32_t below( uint32_t bound ){
+            return random_below(next(), bound);
+        }
+
+        /* Uniform in [0, 1). */
+        double uniform(){
+            return next() * (1.0 / 4294967296.0);
+        }
+    };
+
+    /**
+     * Batched generator: choice[i] is uniform in [0, bound[i]) for walk ids
+     * firstid + i at the given hop. The iterations are independent, so the
+     * loop vectorizes and can be split among threads.
+     */
+    static inline void random_batch( uint32_t seed, uint32_t firstid, unsigned hop, uint32_t stream,
+            const uint32_t *bound, uint32_t *choice, int n ){
+        uint32_t key = seed ^ (stream * PHILOX_W32);
+        for( int i = 0; i < n; i++ ){
+            uint64_t ctr = ((uint64_t)(firstid + i) << 32) | ((uint64_t)(hop & 0xffff) << 16);
+            choice[i] = random_below((uint32_t)(philox2x32(ctr, key) >> 32), bound[i]);
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef DEF_GRAPHCHI_WALKSCHEDULER
+#define DEF_GRAPHCHI_WALKSCHEDULER
+
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "logger/logger.hpp"
+#include "util/cmdopts.hpp"
+#include "walks/walk.hpp"
+
+namespace graphchi {
+
+    /**
+     * Estimates the time to load an interval from the size of its shard
+     * files and the load throughput measured so far, and the time to
+     * advance walks from the measured step rate. Both rates are smoothed
+     * over the intervals executed.
+     */
+    class walkCostModel {
+        std::vector<size_t> bytes;
+        double bytes_per_sec, steps_per_sec;
+
+    public:
+        walkCostModel(std::vector<size_t> &_bytes, double initial_bytes_per_sec) : bytes(_bytes),
+            bytes_per_sec(initial_bytes_per_sec), steps_per_sec(0) {}
+
+        double load_time(int p) {
+            return bytes[p] / bytes_per_sec;
+        }
+
+        /* Zero until an interval was executed. */
+        double exec_time(long steps) {
+            return steps_per_sec > 0 ? steps / steps_per_sec : 0;
+        }
+
+        double step_rate() {
+            return steps_per_sec;
+        }
+
+        void observe_load(int p, double seconds) {
+            if (seconds <= 0 || bytes[p] == 0) return;
+            bytes_per_sec = 0.5 * bytes_per_sec + 0.5 * (bytes[p] / seconds);
+        }
+
+        void observe_exec(long steps, double seconds) {
+            if (seconds <= 0 || steps == 0) return;
+            double rate = steps / seconds;
+            steps_per_sec = steps_per_sec > 0 ? 0.5 * steps_per_sec + 0.5 * rate : rate;
+        }
+
+        /**
+         * Walk steps gained per second by executing p: each pending walk
+         * advances at least one step. Nothing has to be loaded for the
+         * interval cur that is still in memory.
+         */
+        double benefit(walkManager &walk_manager, int p, int cur = -1) {
+            long walks = walk_manager.getWalksDis(p);
+            if (walks == 0) return 0;
+            return walks / ((p == cur ? 0 : load_time(p)) + exec_time(walks));
+        }
+    };
+
+    /**
+     * Picks the next interval to execute. Policies are selected with the
+     * option walk.scheduler. With walk.earlystop=1 the walks of an interval
+     * are left for a later visit once a pass over the interval advances
+     * fewer steps per second than loading the best other interval would.
+     */
+    class walkScheduler {
+    protected:
+        int nshards;
+        walkCostModel &cost;
+        bool earlystop;
+
+    public:
+        walkScheduler(int _nshards, walkCostModel &_cost) : nshards(_nshards), cost(_cost) {
+            earlystop = get_option_int("walk.earlystop", 0) == 1;
+        }
+        virtual ~walkScheduler() {}
+
+        virtual int next_interval(walkManager &walk_manager, int cur) = 0;
+
+        /* Called after interval p was loaded in load_seconds and executed. */
+        virtual void interval_done(int p, double load_seconds, long steps, double exec_seconds) {
+            cost.observe_load(p, load_seconds);
+            cost.observe_exec(steps, exec_seconds);
+        }
+
+        /**
+         * Called after each pass over interval p that advanced steps walk
+         * steps in seconds; returns false to leave the interval.
+         */
+        virtual bool continue_interval(walkManager &walk_manager, int p, long steps, double seconds) {
+            if (!earlystop || seconds <= 0 || cost.step_rate() == 0) return true;
+            double best = 0;
+            for (int q = 0; q < nshards; q++) {
+                if (q != p) best = std::max(best, cost.benefit(walk_manager, q));
+            }
+            return steps / seconds >= best;
+        }
+    };
+
+    /* Interval with the most walks. */
+    class maxwalks_scheduler : public walkScheduler {
+    public:
+        maxwalks_scheduler(int _nshards, walkCostModel &_cost) : walkScheduler(_nshards, _cost) {}
+
+        int next_interval(walkManager &walk_manager, int cur) {
+            return walk_manager.intervalWithMaxWalks();
+        }
+    };
+
+    /**
+     * With probability prob the interval holding the walk with the fewest
+     * hops, so that no walk falls too far behind, otherwise the one with
+     * the most walks. A uniformly random interval instead if random is set.
+     */
+    class minstep_scheduler : public walkScheduler {
+        float prob;
+        bool random;
+    public:
+        minstep_scheduler(int _nshards, walkCostModel &_cost, float _prob, bool _random) : walkScheduler(_nshards, _cost),
+            prob(_prob), random(_random) {}
+
+        int next_interval(walkManager &walk_manager, int cur) {
+            int cc = rand() % 100;
+            if (cc < (int)(prob * 100)) {
+                int p = random ? walk_manager.intervalWithRandom() : walk_manager.intervalWithMinStep();
+                if (p != cur) return p;
+            }
+            return walk_manager.intervalWithMaxWalks();
+        }
+    };
+
+    /* Interval with the most walks per hop of its least advanced walk. */
+    class weighted_scheduler : public walkScheduler {
+    public:
+        weighted_scheduler(int _nshards, walkCostModel &_cost) : walkScheduler(_nshards, _cost) {}
+
+        int next_interval(walkManager &walk_manager, int cur) {
+            return walk_manager.intervalWithMaxWeight();
+        }
+    };
+
+    /* Intervals in order, skipping the ones without walks. */
+    class roundrobin_scheduler : public walkScheduler {
+    public:
+        roundrobin_scheduler(int _nshards, walkCostModel &_cost) : walkScheduler(_nshards, _cost) {}
+
+        int next_interval(walkManager &walk_manager, int cur) {
+            for (int i = 1; i <= nshards; i++) {
+                int p = (cur + i) % nshards;
+                if (walk_manager.getWalksDis(p) > 0) return p;
+            }
+            return walk_manager.intervalWithMaxWalks();
+        }
+    };
+
+    /* Interval that advances the most walk steps per second of load and execution. */
+    class cost_scheduler : public walkScheduler {
+    public:
+        cost_scheduler(int _nshards, walkCostModel &_cost) : walkScheduler(_nshards, _cost) {}
+
+        int next_interval(walkManager &walk_manager, int cur) {
+            int bestp = walk_manager.intervalWithMaxWalks();
+            double best = cost.benefit(walk_manager, bestp, cur);
+            for (int p = 0; p < nshards; p++) {
+                double b = cost.benefit(walk_manager, p, cur);
+                if (b > best) {
+                    best = b;
+                    bestp = p;
+                }
+            }
+            return bestp;
+        }
+    };
+
+    /**
+     * Creates the scheduler named by the option walk.scheduler:
+     * maxwalks, minstep, random, weighted, roundrobin or cost.
+     */
+    static walkScheduler * create_walk_scheduler(int nshards, walkCostModel &cost, float prob) {
+        std::string name = get_option_string("walk.scheduler", "minstep");
+        logstream(LOG_INFO) << "Walk scheduler: " << name << std::endl;
+        if (name == "maxwalks") return new maxwalks_scheduler(nshards, cost);
+        if (name == "minstep") return new minstep_scheduler(nshards, cost, prob, false);
+        if (name == "random") return new minstep_scheduler(nshards, cost, prob, true);
+        if (name == "weighted") return new weighted_scheduler(nshards, cost);
+        if (name == "roundrobin") return new roundrobin_scheduler(nshards, cost);
+        if (name == "cost") return new cost_scheduler(nshards, cost);
+        logstream(LOG_FATAL) << "Unknown walk.scheduler " << name << ", expected maxwalks, minstep, random, weighted, roundrobin or cost." << std::endl;
+        assert(false);
+        return NULL;
+    }
+}
+
+#endif
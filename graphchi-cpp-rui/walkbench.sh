@@ -0,0 +1,142 @@
+#!/bin/bash
+# Random walk benchmark of graphchi and GraphWalker on the same graphs.
+#
+# Generates or prepares every graph preset, partitions it for both engines
+# and runs the walks for every scheduler, memory budget and thread count.
+# One CSV line per run goes to $OUT:
+#   engine,graph,vertices,edges,scheduler,threads,membudget_mb,walks,steps,
+#   runtime_s,steps_per_s,block_loads,bytes_read,io_s,walk_s,schedule_s
+# steps are the walk steps each engine counted (metric walk_steps), as the
+# engines start and stop different numbers of walks.
+# graphchi runs out of core (inmemory 0) like GraphWalker, even for graphs
+# that fit into the memory budget. SEED fixes the walks of both engines for
+# any number of threads; graphchi also needs loadthreads 1 to repeat a run
+# exactly, as parallel shard loading orders the out-edges differently.
+# io_s is loading (and for graphchi writing back) intervals or blocks,
+# walk_s executing the walks and schedule_s picking the next interval or
+# block plus moving the walks between them.
+#
+# usage: ./walkbench.sh [preset ...]
+#   presets: rmat-<scale>, er-<n>-<p>, file:<edge list>   (default rmat-16 er-4000-0.002)
+# Settings are taken from the environment, e.g.
+#   THREADS="1 4" MEMBUDGETS="64 1024" NWALKS=1000000 ./walkbench.sh rmat-20
+
+set -e
+
+GRAPHCHI=$(cd "$(dirname "$0")" && pwd)
+GRAPHWALKER=${GRAPHWALKER:-"$GRAPHCHI/../GraphWalker (partition)"}
+WORKDIR=${WORKDIR:-"$GRAPHCHI/benchdata"}
+OUT=${OUT:-"$GRAPHCHI/walkbench.csv"}
+
+NWALKS=${NWALKS:-100000}
+NSTEPS=${NSTEPS:-10}
+SEED=${SEED:-1}
+EDGEFACTOR=${EDGEFACTOR:-16}
+# Intervals of graphchi; GraphWalker blocks are sized to give about as many
+PARTS=${PARTS:-8}
+THREADS=${THREADS:-"1 $(nproc)"}
+MEMBUDGETS=${MEMBUDGETS:-"64 1024"}
+SCHEDULERS=${SCHEDULERS:-"maxwalks minstep roundrobin cost"}
+
+PRESETS=${@:-"rmat-16 er-4000-0.002"}
+
+make -C "$GRAPHCHI" apps generators > /dev/null 2>&1 || { echo "Could not build graphchi" >&2; exit 1; }
+make -C "$GRAPHWALKER" apps > /dev/null 2>&1 || { echo "Could not build GraphWalker" >&2; exit 1; }
+mkdir -p "$WORKDIR"
+
+# Value of a metric in a metrics file, 0 if it was not recorded; count rounds it
+metric() {
+    local v
+    v=$(grep -m1 "^\.$2=" "$1" | cut -d= -f2)
+    echo "${v:-0}"
+}
+
+count() {
+    printf "%.0f" "$(metric "$1" "$2")"
+}
+
+# Steps per second, 0 for a run without a measured runtime
+rate() {
+    awk "BEGIN { printf \"%.0f\", ($2 > 0 ? $1 / $2 : 0) }"
+}
+
+sum() {
+    awk 'BEGIN { s = 0; for (i = 1; i < ARGC; i++) s += ARGV[i]; printf "%f", s }' "$@"
+}
+
+# Sorted edge list of a preset in $WORKDIR, printed as its path
+prepare() {
+    local preset=$1 name graph
+    case $preset in
+        rmat-*)
+            name=$preset
+            graph="$WORKDIR/$name.txt"
+            if [ ! -f "$graph" ]; then
+                (cd "$WORKDIR" && "$GRAPHCHI/bin/util/graphgenerators" rmat "${preset#rmat-}" $EDGEFACTOR $SEED > /dev/null)
+                mv "$WORKDIR/rmat_${preset#rmat-}.edgelist" "$graph"
+            fi;;
+        er-*)
+            local args=(${preset//-/ })
+            name=$preset
+            graph="$WORKDIR/$name.txt"
+            if [ ! -f "$graph" ]; then
+                (cd "$WORKDIR" && "$GRAPHCHI/bin/util/erdosrenyi" bench ${args[1]} ${args[2]} $SEED > /dev/null)
+                sort -n -k1,1 -k2,2 "$WORKDIR"/erdosrenyi_bench_${args[1]}_*.edgelist > "$graph"
+                rm -f "$WORKDIR"/erdosrenyi_bench_${args[1]}_*.edgelist
+            fi;;
+        file:*)
+            name=$(basename "${preset#file:}")
+            graph="$WORKDIR/$name"
+            [ -f "$graph" ] || grep -v '^[#%]' "${preset#file:}" | sort -n -k1,1 -k2,2 > "$graph";;
+        *)
+            echo "Unknown preset $preset" >&2
+            exit 1;;
+    esac
+    echo "$graph"
+}
+
+[ -f "$OUT" ] || echo "engine,graph,vertices,edges,scheduler,threads,membudget_mb,walks,steps,runtime_s,steps_per_s,block_loads,bytes_read,io_s,walk_s,schedule_s" > "$OUT"
+
+for preset in $PRESETS; do
+    graph=$(prepare $preset)
+    name=$(basename "$graph")
+    vertices=$(awk 'BEGIN { m = -1 } { if ($1 > m) m = $1; if ($2 > m) m = $2 } END { print m + 1 }' "$graph")
+    edges=$(wc -l < "$graph")
+    # A block file holds about two ints per vertex and one per edge
+    blocksize_kb=$(( (2 * vertices + edges) * 4 / 1024 / PARTS + 1 ))
+    echo "$name: $vertices vertices, $edges edges" >&2
+
+    for threads in $THREADS; do
+        for membudget in $MEMBUDGETS; do
+            for scheduler in $SCHEDULERS; do
+                metrics="$WORKDIR/metrics.txt"
+                rm -f "$metrics"
+                (cd "$GRAPHCHI" && bin/applications/pagerank file "$graph" nvertices $vertices nwalks $NWALKS nsteps $NSTEPS \
+                    filetype edgelist nshards $PARTS execthreads $threads membudget_mb $membudget walk.scheduler $scheduler seed $SEED \
+                    inmemory 0 metrics.reporter console,file metrics.reporter.filename "$metrics" > /dev/null 2>&1)
+                runtime=$(metric "$metrics" runtime)
+                steps=$(count "$metrics" walk_steps)
+                echo "graphchi,$name,$vertices,$edges,$scheduler,$threads,$membudget,$NWALKS,$steps,$runtime,$(rate $steps $runtime)" \
+                    ",$(count "$metrics" _before_exec_interval.count),$(count "$metrics" io_bytes_read)" \
+                    ",$(sum $(metric "$metrics" _before_exec_interval) $(metric "$metrics" _after_exec_interval))" \
+                    ",$(metric "$metrics" execute-updates)" \
+                    ",$(sum $(metric "$metrics" _schedule) $(metric "$metrics" _merge-outboxes))" | tr -d ' ' >> "$OUT"
+            done
+
+            # GraphWalker always executes the block with the most walks
+            metrics="$WORKDIR/metrics.txt"
+            rm -f "$metrics"
+            (cd "$GRAPHWALKER" && bin/app/avgdegree file "$graph" nvertices $vertices nwalks $NWALKS nsteps $NSTEPS \
+                blocksize_kb $blocksize_kb execthreads $threads membudget_mb $membudget seed $SEED \
+                metrics.reporter console,file metrics.reporter.filename "$metrics" > /dev/null 2>&1)
+            runtime=$(metric "$metrics" runtime)
+            steps=$(count "$metrics" walk_steps)
+            echo "graphwalker,$name,$vertices,$edges,maxwalks,$threads,$membudget,$NWALKS,$steps,$runtime,$(rate $steps $runtime)" \
+                ",$(count "$metrics" block_loads),$(count "$metrics" block_bytes_read)" \
+                ",$(sum $(metric "$metrics" _load-block) $(metric "$metrics" _wait-prefetch) $(metric "$metrics" _read-walks))" \
+                ",$(metric "$metrics" _exec-updates)" \
+                ",$(sum $(metric "$metrics" _find-block-with-max-walks) $(metric "$metrics" _merge-local-walks))" | tr -d ' ' >> "$OUT"
+        done
+    done
+done
+echo "Results in $OUT" >&2